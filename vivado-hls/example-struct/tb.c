@@ -0,0 +1,8 @@
+#include "test.h"
+ 
+int main () {
+   int retval = 0;
+   int result = test();
+   if(result!=12) retval = 1;
+   return retval;
+}
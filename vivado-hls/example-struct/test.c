@@ -0,0 +1,24 @@
+#include "test.h"
+
+struct pair { int *first; int n; int *second; };
+
+int a, b, c;
+struct pair s1, s2, s3;
+struct pair *src, *dst;
+
+__attribute__((noinline))
+void pick(int k){ dst = k ? &s2 : &s3; }
+
+int test () {
+   a = 1; b = 2; c = 3;
+   s1.first = &a; s1.second = &b;
+   s2.first = &c; s2.second = &c;
+   s3 = s2;
+   src = &s1;
+   pick(1);
+   memcpy(dst, src, sizeof(struct pair));
+   pick(0);
+   memset(dst, 0, sizeof(struct pair));
+   if(s3.first) return 0;
+   return (*s2.first) * 10 + (*s2.second);
+}
@@ -0,0 +1,5 @@
+
+#include <stdio.h>
+#include <string.h>
+
+int test ();
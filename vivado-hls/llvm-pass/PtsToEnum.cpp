@@ -20,23 +20,35 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/ConstantFolder.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 #include "llvm/Transforms/Utils/FunctionComparator.h"
 #include "llvm/IR/SymbolTableListTraits.h"
 #include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
 #include <map>
 #include <vector>
 #include <stack>
+#include <set>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <functional>
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/FormattedStream.h"
+#include "PtsToEnum.h"
 
 
 using namespace llvm;
@@ -44,18 +56,10 @@ using namespace std;
 
 struct PtsToEnum : public ModulePass {
   static char ID;
-  Module *mod; 
-
-  /// The type for the list of global variables.
-  using GlobalListType = SymbolTableList<GlobalVariable>;
-  GlobalListType *gList;
   PtsToEnum() : ModulePass(ID)
   {
   }
   bool runOnModule(Module &M) override;
-  void getAnalysisUsage(AnalysisUsage &AU) const override {
-    AU.setPreservesAll();
-  }
 };
 
 std::error_code EC;
@@ -65,8 +69,23 @@ static RegisterPass<PtsToEnum> X("ptsTo", "Handling pointer accesses",
     false /* Only looks at CFG */,
     true /* Transformation Pass */);
 
+static cl::opt<bool> ProfGen("ptsTo-prof-gen",
+    cl::desc("Count the index observed at each enumerated access"));
+static cl::opt<std::string> ProfUse("ptsTo-prof-use",
+    cl::desc("Order enumerated accesses by an index profile"),
+    cl::value_desc("filename"));
+static cl::opt<unsigned> ProfPeel("ptsTo-prof-peel", cl::init(90),
+    cl::desc("Percentage of accesses above which a target is peeled"));
+static cl::opt<std::string> PoolBounds("ptsTo-pool-bounds",
+    cl::desc("Bounds of the allocation sites that become pools"),
+    cl::value_desc("filename"));
+
 std::vector<Value*> globalVarMap;
+std::vector<Value*> funcVarMap;
 std::map<Value*,Value*> indexMap;
+std::map<Value*,Value*> offsetMap;
+std::map<Value*,Value*> offsetValMap;
+std::map<Value*,Value*> tableAddrMap;
 std::map<Instruction*,std::vector<Value*>> ptsToGraph; 
 std::map<Argument*,std::vector<Value*>> argsPtsToGraph; 
 
@@ -79,13 +98,35 @@ int getIndex(Value *val){
     index = std::distance(globalVarMap.begin(), gv) + 1;
     log << "Index: " << index << "\n";
   }
+  // Functions are enumerated separately, a function pointer index only ever 
+  // selects between functions
+  std::vector<Value*>::iterator fn = std::find(funcVarMap.begin(),funcVarMap.end(),val);
+  if(fn!=funcVarMap.end()) {
+    log << "Function: " << (*fn)->getName() << "\n";
+    index = std::distance(funcVarMap.begin(), fn) + 1;
+    log << "Index: " << index << "\n";
+  }
   return index;
 }
 
+// Index 0 is reserved for null, a pointer to an object that is not enumerated
+// gets an index that no object has
+const int nullIndex = 0;
+const int unknownIndex = -1;
+
 bool isDoublePtr(Value *V) {
   return V->getType()->isPointerTy() && V->getType()->getContainedType(0)->isPointerTy();
 }
 
+// Arrays of pointers, e.g. int *tbl[N], hold indices as well
+bool isPtrTable(Value *V) {
+  if(!V->getType()->isPointerTy()) return false;
+  Type *ty = V->getType()->getContainedType(0);
+  if(!ty->isArrayTy()) return false;
+  while(ty->isArrayTy()) ty = ty->getArrayElementType();
+  return ty->isPointerTy();
+}
+
 string getString(Value *V){
   std::string tmp;
   raw_string_ostream Out(tmp);
@@ -93,6 +134,189 @@ string getString(Value *V){
   return tmp;
 }
 
+// Struct fields are objects of their own, identified by a constant GEP into
+// the global struct, e.g. (@s, 0, 1) for the second field of s
+void addFieldObjects(GlobalVariable *GV, std::vector<Constant*> &path, Type *ty, 
+    std::vector<Value*> &objects){
+  if(!ty->isStructTy()){
+    objects.push_back(ConstantExpr::getInBoundsGetElementPtr(GV->getValueType(), GV, path));
+    return;
+  }
+  Type *intTy = TypeBuilder<int,false>::get(GV->getContext());
+  for(unsigned f = 0; f < ty->getStructNumElements(); f++){
+    path.push_back(ConstantInt::get(intTy, f));
+    addFieldObjects(GV, path, ty->getStructElementType(f), objects);
+    path.pop_back();
+  }
+}
+
+// Gets the object an address points into. Addresses of struct fields give the
+// field, any other GEP gives its base object.
+Value *getObject(Value *ptr){
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(ptr);
+  if(!gepOp) return ptr;
+  Value *base = gepOp->getPointerOperand();
+  GlobalVariable *GV = dyn_cast<GlobalVariable>(base);
+  if(!GV || !GV->getValueType()->isStructTy() || !gepOp->hasAllConstantIndices()) return base;
+  if(!dyn_cast<Constant>(*gepOp->idx_begin())->isNullValue()) return base;
+
+  Type *intTy = TypeBuilder<int,false>::get(GV->getContext());
+  std::vector<Constant*> path;
+  path.push_back(ConstantInt::get(intTy, 0));
+  Type *ty = GV->getValueType();
+  for(auto ind = gepOp->idx_begin() + 1; ind != gepOp->idx_end() && ty->isStructTy(); ind++){
+    unsigned f = dyn_cast<ConstantInt>(*ind)->getZExtValue();
+    path.push_back(ConstantInt::get(intTy, f));
+    ty = ty->getStructElementType(f);
+  }
+  // The address of a nested struct is the address of its first field
+  while(ty->isStructTy()){
+    path.push_back(ConstantInt::get(intTy, 0));
+    ty = ty->getStructElementType(0);
+  }
+  Constant *field = ConstantExpr::getInBoundsGetElementPtr(GV->getValueType(), GV, path);
+  if(std::find(globalVarMap.begin(), globalVarMap.end(), field) == globalVarMap.end()) return base;
+  return field;
+}
+
+// Gets the field object if an address is exactly a struct field
+Value *getFieldAddr(Value *ptr){
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(ptr);
+  if(!gepOp) return ptr;
+  Value *field = getObject(ptr);
+  if(field == gepOp->getPointerOperand()) return ptr;
+  GEPOperator *fieldOp = dyn_cast<GEPOperator>(field);
+  if(fieldOp->getNumIndices() != gepOp->getNumIndices()) return ptr;
+  return field;
+}
+
+// Gets where the index of a pointer stored at ptr lives, if it is enumerated.
+// Elements of pointer tables are at the same position of their index table.
+Value *getIndexAddr(Value *ptr){
+  std::map<Value*,Value*>::iterator it = indexMap.find(getFieldAddr(ptr));
+  if(it != indexMap.end()) return it->second;
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(ptr);
+  if(!gepOp || !ptr->getType()->getContainedType(0)->isPointerTy()) return NULL;
+  it = indexMap.find(gepOp->getPointerOperand());
+  if(it == indexMap.end() || !isPtrTable(it->first)) return NULL;
+
+  std::map<Value*,Value*>::iterator elem = tableAddrMap.find(ptr);
+  if(elem != tableAddrMap.end()) return elem->second;
+  GlobalVariable *tbl = dyn_cast<GlobalVariable>(it->second);
+  Value *elemAddr;
+  if(isa<Constant>(ptr)){
+    std::vector<Constant*> idx;
+    for(auto ind = gepOp->idx_begin(); ind != gepOp->idx_end(); ind++)
+      idx.push_back(dyn_cast<Constant>(*ind));
+    elemAddr = ConstantExpr::getInBoundsGetElementPtr(tbl->getValueType(), tbl, idx);
+  } else {
+    GetElementPtrInst *gepInst = dyn_cast<GetElementPtrInst>(ptr);
+    std::vector<Value*> idx(gepInst->idx_begin(), gepInst->idx_end());
+    elemAddr = GetElementPtrInst::CreateInBounds(tbl->getValueType(), tbl, idx, gepInst->getName() + "_index", gepInst);
+  }
+  tableAddrMap[ptr] = elemAddr;
+  return elemAddr;
+}
+
+// Index tables have the shape of their pointer table
+Type *getIndexType(Type *ty, Type *intTy){
+  if(!ty->isArrayTy()) return intTy;
+  return ArrayType::get(getIndexType(ty->getArrayElementType(), intTy), ty->getArrayNumElements());
+}
+
+// Turns the initializer of a pointer table into the indices of the objects
+// it points to
+Constant *getIndexInit(Constant *init, Type *idxTy){
+  if(!init || isa<UndefValue>(init) || init->isNullValue()) return ConstantInt::get(idxTy, nullIndex);
+  if(idxTy->isArrayTy()){
+    std::vector<Constant*> elems;
+    for(unsigned k = 0; k < idxTy->getArrayNumElements(); k++)
+      elems.push_back(getIndexInit(init->getAggregateElement(k), idxTy->getArrayElementType()));
+    return ConstantArray::get(dyn_cast<ArrayType>(idxTy), elems);
+  }
+  int index = getIndex(getObject(init->stripPointerCasts()));
+  return ConstantInt::get(idxTy, index>0 ? index : unknownIndex, true);
+}
+
+// Initial value of the pointer held at a slot, fields are looked up in the 
+// initializer of their struct
+Constant *getSlotInit(Value *slot){
+  if(GlobalVariable *GV = dyn_cast<GlobalVariable>(slot))
+    return GV->hasInitializer() ? GV->getInitializer() : NULL;
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(slot);
+  if(!gepOp) return NULL;
+  Constant *init = getSlotInit(gepOp->getPointerOperand());
+  for(auto ind = gepOp->idx_begin() + 1; ind != gepOp->idx_end() && init; ind++)
+    init = init->getAggregateElement(dyn_cast<Constant>(*ind));
+  return init;
+}
+
+// Gets where the offset of a pointer stored at ptr lives, only pointers that
+// move within their object carry one
+Value *getOffsetAddr(Value *ptr){
+  std::map<Value*,Value*>::iterator it = offsetMap.find(getFieldAddr(ptr));
+  if(it != offsetMap.end()) return it->second;
+  return NULL;
+}
+
+// Name of an object in the external points-to file, fields are @s/1
+string getObjLabel(Value *obj){
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(obj);
+  if(!gepOp) return getString(obj);
+  string label = getString(gepOp->getPointerOperand());
+  for(auto ind = gepOp->idx_begin() + 1; ind != gepOp->idx_end(); ind++)
+    label += "/" + std::to_string(dyn_cast<ConstantInt>(*ind)->getZExtValue());
+  return label;
+}
+
+// Name of an object for the values we create, fields are s_1
+string getObjName(Value *obj){
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(obj);
+  if(!gepOp || !isa<Constant>(obj)) return obj->getName().str();
+  string name = gepOp->getPointerOperand()->getName().str();
+  for(auto ind = gepOp->idx_begin() + 1; ind != gepOp->idx_end(); ind++)
+    name += "_" + std::to_string(dyn_cast<ConstantInt>(*ind)->getZExtValue());
+  return name;
+}
+
+// Number of pointer levels of a type, an int** has two
+int getPtrDepth(Type *ty){
+  int depth = 0;
+  for(; ty->isPointerTy(); ty = ty->getContainedType(0)) depth++;
+  return depth;
+}
+
+// Checks whether an access of type accessTy can be done on an object. Pointers
+// are accessed through their index, which only selects between objects of the
+// level below.
+bool isCompatible(Value *obj, Type *accessTy){
+  Type *objTy = obj->getType()->getContainedType(0);
+  if(indexMap.find(obj) != indexMap.end()) 
+    return accessTy->isPointerTy() && getPtrDepth(objTy) == getPtrDepth(accessTy);
+  return objTy == accessTy;
+}
+
+// Constant globals are never written, constant tables end up as ROMs
+bool isReadOnly(Value *obj){
+  if(GEPOperator *gepOp = dyn_cast<GEPOperator>(obj)) obj = gepOp->getPointerOperand();
+  GlobalVariable *GV = dyn_cast<GlobalVariable>(obj);
+  return isa<Function>(obj) || (GV && GV->isConstant());
+}
+
+// Checks whether an object is or decays to elements of type elemTy, as arrays 
+// do in C
+bool decaysTo(Value *obj, Type *elemTy){
+  Type *ty = obj->getType()->getContainedType(0);
+  while(ty != elemTy && ty->isArrayTy())
+    ty = ty->getArrayElementType();
+  return ty == elemTy;
+}
+
+// Checks whether a GEP can be rebuilt on an object
+bool isGepCompatible(Value *obj, GetElementPtrInst *gepInst){
+  return decaysTo(obj, gepInst->getSourceElementType());
+}
+
 int strToInt(std::string str) {
   int out;
   std::stringstream convert(str);
@@ -103,10 +327,18 @@ int strToInt(std::string str) {
 int ptsCount = 0;
 int instCount = 0;
 
-void getExternalPtsToForArgs(Argument *I) {
-  llvm::formatted_raw_ostream log(logFile);
+// Resolves a name from the external points-to file to globals and functions
+void findPtsToTarget(string name, PtsToInfo &info, std::vector<Value*> &ptsToSet) {
+  for(vector<Value*>::iterator gvar = info.objects.begin(); gvar != info.objects.end(); gvar++){
+    if(getObjLabel(*gvar)==name) ptsToSet.push_back(*gvar);
+  }
+  for(vector<Value*>::iterator fn = info.functions.begin(); fn != info.functions.end(); fn++){
+    if(getString(*fn)==name) ptsToSet.push_back(*fn);
+  }
+}
+
+void getExternalPtsToForArgs(Argument *I, PtsToInfo &info) {
   assert(isa<Argument>(I));
-  log << "Argument is " << *I << "\n";
   std::ifstream infile("pointsTo.Vitis");
   bool found = false;
   if (infile.is_open()) {
@@ -119,7 +351,6 @@ void getExternalPtsToForArgs(Argument *I) {
       getline(linestream,val,':');
       // Check if it is the right function for SSA reasons
       if(val == I->getParent()->getName()){
-        log << "Found function " << val << "\n";
         // Read first column
         getline(linestream,val,':');
         //Handling Load Instruction
@@ -140,22 +371,13 @@ void getExternalPtsToForArgs(Argument *I) {
 
           // Check if the Instruction and input aa line is a match
           if(op0==argLabelComp){
-            log << "Found a match!\n";
             if(count>0){
               string globalName;
               std::vector<Value*> ptsToSet;
               while(getline(linestream, globalName, ':')){
-                //log << "Global name is " << globalName << "\n";
-                for(vector<Value*>::iterator gvar = globalVarMap.begin(); gvar != globalVarMap.end(); gvar++){
-                  Value *g = *gvar;
-                  string name = getString(g);
-                  if(name==globalName) {
-                    log << "Found inst: " << *g << "\n";
-                    ptsToSet.push_back(*gvar);
-                  }
-                }
+                findPtsToTarget(globalName, info, ptsToSet);
               }
-              argsPtsToGraph[&(*I)] = ptsToSet;
+              info.argsPtsTo[&(*I)] = ptsToSet;
             }
           }
         }
@@ -163,24 +385,18 @@ void getExternalPtsToForArgs(Argument *I) {
     }
   }
   infile.close();
-  log << "Finished\n";
 }
 
 
-void getExternalPtsTo(Module *mod){
-  llvm::formatted_raw_ostream log(logFile);
-
+void getExternalPtsTo(Module *mod, PtsToInfo &info){
   // Extracting external point 
   for(Module::iterator F = mod->begin(); F != mod->end(); F++){
     for(Function::iterator BB = F->begin(); BB != F->end(); BB++){
       for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++){
-        if(isa<StoreInst>(I)||isa<LoadInst>(I)||isa<GetElementPtrInst>(I)){
-          log << "Function is " << F->getName() << "\n";
-          log << "Instruction is " << *I << "\n";
+        if(isa<StoreInst>(I)||isa<LoadInst>(I)||isa<GetElementPtrInst>(I)||isa<CallInst>(I)){
           std::ifstream infile("pointsTo.Vitis");
           bool found = false;
-          std::vector<Value*> inPtsToSet = ptsToGraph[&(*I)];
-          log << "Size is " << inPtsToSet.size() << "\n";
+          std::vector<Value*> inPtsToSet = info.ptsTo[&(*I)];
           if(inPtsToSet.size()>0) continue;
 
           if (infile.is_open()) {
@@ -210,22 +426,14 @@ void getExternalPtsTo(Module *mod){
 
                     // Check if the Instruction and input aa line is a match
                     if(op0==labelName && op1==addrLabelComp){
-                      log << "Found a match!\n";
                       found = true;
                       if(count>0){
                         string globalName;
                         std::vector<Value*> ptsToSet;
                         while(getline(linestream, globalName, ':')){
-                          for(vector<Value*>::iterator gvar = globalVarMap.begin(); gvar != globalVarMap.end(); gvar++){
-                            Value *g = *gvar;
-                            string name = getString(g);
-                            if(name==globalName) {
-                              log << "Found inst: " << name << "\n";
-                              ptsToSet.push_back(*gvar);
-                            }
-                          }
+                          findPtsToTarget(globalName, info, ptsToSet);
                         }
-                        ptsToGraph[&(*I)] = ptsToSet;
+                        info.ptsTo[&(*I)] = ptsToSet;
                       }
                     }
                   }
@@ -246,23 +454,14 @@ void getExternalPtsTo(Module *mod){
 
                     // Check if the Instruction and input aa line is a match
                     if(op0==writeLabelComp && op1==addrLabelComp){
-                      log << "Found a match!\n";
                       found = true;
                       if(count>0){
                         string globalName;
                         std::vector<Value*> ptsToSet;
                         while(getline(linestream, globalName, ':')){
-                          //log << "Global name is " << globalName << "\n";
-                          for(vector<Value*>::iterator gvar = globalVarMap.begin(); gvar != globalVarMap.end(); gvar++){
-                            Value *g = *gvar;
-                            string name = getString(g);
-                            if(name==globalName) {
-                              log << "Found inst: " << *g << "\n";
-                              ptsToSet.push_back(*gvar);
-                            }
-                          }
+                          findPtsToTarget(globalName, info, ptsToSet);
                         }
-                        ptsToGraph[&(*I)] = ptsToSet;
+                        info.ptsTo[&(*I)] = ptsToSet;
                       }
                     }
                   }
@@ -280,24 +479,39 @@ void getExternalPtsTo(Module *mod){
                     int count = strToInt(countstr);
                     // Check if the Instruction and input aa line is a match
                     if(write==writeLabel){
-                      log << "Found a match!\n";
                       found = true;
                       // Check count of whether AA gives us any info
                       if(count>0){
                         string globalName;
                         std::vector<Value*> ptsToSet;
                         while(getline(linestream, globalName, ':')){
-                          //log << "Global name is " << globalName << "\n";
-                          for(vector<Value*>::iterator gvar = globalVarMap.begin(); gvar != globalVarMap.end(); gvar++){
-                            Value *g = *gvar;
-                            string name = getString(g);
-                            if(name==globalName) {
-                              log << "Found inst: " << *g << "\n";
-                              ptsToSet.push_back(*gvar);
-                            }
-                          }
+                          findPtsToTarget(globalName, info, ptsToSet);
+                        }
+                        info.ptsTo[&(*I)] = ptsToSet;
+                      }
+                    }
+                  }
+                }
+                else if(CallInst *V = dyn_cast<CallInst>(I)){
+                  if(val =="call"){
+                    // Get the called operand, only indirect calls have a label
+                    string calleeLabel = getString(V->getCalledValue());
+                    // Read the next three columns
+                    string callee,op0,countstr;
+                    getline(linestream,callee,':');
+                    getline(linestream,op0,':');
+                    getline(linestream,countstr,':');
+                    int count = strToInt(countstr);
+                    // Check if the Instruction and input aa line is a match
+                    if(callee==calleeLabel){
+                      found = true;
+                      if(count>0){
+                        string globalName;
+                        std::vector<Value*> ptsToSet;
+                        while(getline(linestream, globalName, ':')){
+                          findPtsToTarget(globalName, info, ptsToSet);
                         }
-                        ptsToGraph[&(*I)] = ptsToSet;
+                        info.ptsTo[&(*I)] = ptsToSet;
                       }
                     }
                   }
@@ -325,561 +539,2319 @@ void printPtsTo(){
   }
 }
 
-bool PtsToEnum::runOnModule(Module &M) {
-  LLVMContext &c = M.getContext();
-  mod = &M;
-  gList = &mod->getGlobalList();
+// Gets the offset of a pointer within the object it points into, counted in
+// elements of its pointee type. NULL stands for no offset.
+Value *getOffsetValue(IRBuilder<> &builder, Value *ptr){
   llvm::formatted_raw_ostream log(logFile);
-
-  // Creating indices for globals 
-  for (auto GV = gList->begin(); GV != gList->end(); GV++){
-    // Getting globals that are pointers 
-    //if(GV->getType()->isPointerTy()){
-      if(
-          // Avoiding all llvm metadata or strings 
-          GV->getLinkage()!=GlobalValue::PrivateLinkage && 
-          GV->getLinkage()!=GlobalValue::AppendingLinkage
-          // and not considering arrays either for now! 
-          //!GV->getType()->getContainedType(0)->isAggregateType()
-        ){
-        globalVarMap.push_back(&(*GV));
-        log << "Pushing " << *GV << "\n";
+  Type *intTy = TypeBuilder<int,false>::get(ptr->getContext());
+  std::map<Value*,Value*>::iterator it = offsetValMap.find(ptr);
+  if(it != offsetValMap.end()) return it->second;
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(ptr);
+  if(!gepOp) return NULL;
+
+  // Arrays are linearised, the first index moves over whole pointees
+  Value *off = getOffsetValue(builder, gepOp->getPointerOperand());
+  Type *ty = gepOp->getSourceElementType();
+  string name = ptr->getName().str() + "_off";
+  for(auto ind = gepOp->idx_begin(); ind != gepOp->idx_end(); ind++){
+    Constant *offConst = dyn_cast_or_null<Constant>(off);
+    if(offConst && offConst->isNullValue()) off = NULL;
+    Value *idx = builder.CreateSExtOrTrunc(*ind, intTy, name);
+    if(ind != gepOp->idx_begin() && ty->isStructTy()){
+      // Fields are objects of their own, we only get at them from their start
+      if(off){
+        log << "Offset across struct fields: " << *ptr << "\n";
+        return NULL;
       }
-    //}
-  }
-  // Identifies all global variables that are double pointers  
-  // For each identified variable, we create another variable that is not a pointer to hold the index
-  for (auto GV = gList->begin(); GV != gList->end(); GV++){
-    //int index = getIndex(&(*GV));
-    if(
-        isDoublePtr(&(*GV))
-        //|| GV->getType()->getContainedType(0)->isAggregateType()
-      ){
-      log << "Double pointer spotted: " << *GV << "\n";
-      Value *indexedGVal = M.getOrInsertGlobal(GV->getName().str() + "_index", TypeBuilder<int,false>::get(c));
-      GlobalVariable *indexedGVar = dyn_cast<GlobalVariable>(indexedGVal);       
-      indexedGVar->setInitializer(ConstantInt::get(c, APInt(32,0)));
-      log << "Creating global variable " << *indexedGVar; 
-      indexMap[&(*GV)] = indexedGVar;
-      log << "\n";
+      ty = ty->getStructElementType(dyn_cast<ConstantInt>(*ind)->getZExtValue());
+      continue;
+    }
+    if(ind != gepOp->idx_begin()){
+      if(!ty->isArrayTy()) return NULL;
+      if(off) off = builder.CreateMul(off, ConstantInt::get(intTy, ty->getArrayNumElements()), name);
+      ty = ty->getArrayElementType();
     }
+    off = off ? builder.CreateAdd(off, idx, name) : idx;
   }
-  log << "size of indexMap is " << indexMap.size() << "\n";
+  Constant *offConst = dyn_cast_or_null<Constant>(off);
+  if(offConst && offConst->isNullValue()) return NULL;
+  return off;
+}
 
-  int retVal = system("if [ -f config ]; then exit 1; else exit 0; fi");
-  log << "Return value was " << retVal << "\n";
+// Checks whether a stored pointer can point past the start of its object,
+// merges can if any of their incoming pointers can
+bool isPtrArith(Value *val, std::set<Value*> &visited){
+  if(!visited.insert(val).second) return false;
+  if(LoadInst *lInst = dyn_cast<LoadInst>(val))
+    return getOffsetAddr(lInst->getPointerOperand()) != NULL;
+  if(SelectInst *sel = dyn_cast<SelectInst>(val))
+    return isPtrArith(sel->getTrueValue(), visited) || isPtrArith(sel->getFalseValue(), visited);
+  if(PHINode *phi = dyn_cast<PHINode>(val)){
+    for(unsigned k = 0; k < phi->getNumIncomingValues(); k++)
+      if(isPtrArith(phi->getIncomingValue(k), visited)) return true;
+    return false;
+  }
+  if(!isa<GEPOperator>(val)) return false;
+  if(isa<Instruction>(val)) return true;
+  // Constant addresses fold, nothing gets inserted
+  IRBuilder<> builder(val->getContext());
+  return getOffsetValue(builder, val) != NULL;
+}
 
-  if(!retVal){
-    log << "No config!\n";
-    // Find all loads and stores and assign points to all global variables 
-    // This is the most conservative approach 
+// Creates the offset of the pointer held at a slot, starting from where its
+// initializer points
+void createOffsetVar(Module *M, Value *slot){
+  llvm::formatted_raw_ostream log(logFile);
+  Type *intTy = TypeBuilder<int,false>::get(M->getContext());
+  Constant *init = getSlotInit(slot);
+  // Constant addresses fold, nothing gets inserted
+  IRBuilder<> builder(M->getContext());
+  Constant *offInit = init ? dyn_cast_or_null<Constant>(getOffsetValue(builder, init)) : NULL;
+  GlobalVariable *offGVar = new GlobalVariable(*M, intTy, false, GlobalValue::ExternalLinkage,
+      offInit ? offInit : ConstantInt::get(intTy, 0), getObjName(slot) + "_offset");
+  log << "Creating global variable " << *offGVar << "\n";
+  offsetMap[slot] = offGVar;
+}
 
-    for(Module::iterator F = mod->begin(); F != mod->end(); F++){
+// Pointers that move within their objects carry an offset next to their 
+// index. Copies of such pointers carry one as well, so we go until no new 
+// offsets are needed.
+void findFatPointers(Module *M){
+  // Pointers that start inside their object
+  for(std::map<Value*,Value*>::iterator it = indexMap.begin(); it != indexMap.end(); it++){
+    if(it->second->getType()->getContainedType(0)->isAggregateType()) continue;
+    Constant *init = getSlotInit(it->first);
+    IRBuilder<> builder(M->getContext());
+    if(init && getOffsetValue(builder, init)) createOffsetVar(M, it->first);
+  }
+  bool changed = true;
+  while(changed){
+    changed = false;
+    for(Module::iterator F = M->begin(); F != M->end(); F++){
       for(Function::iterator BB = F->begin(); BB != F->end(); BB++){
         for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++){
-          if(isa<StoreInst>(I)||isa<LoadInst>(I)||isa<GetElementPtrInst>(I)){
-            std::vector<Value*> ptsToSet;
-            ptsToSet = globalVarMap;
-            ptsToGraph[&(*I)] = ptsToSet;
+          StoreInst *sInst = dyn_cast<StoreInst>(&(*I));
+          if(!sInst) continue;
+          std::set<Value*> visited;
+          if(!isPtrArith(sInst->getValueOperand(), visited)) continue;
+          std::vector<Value*> slots;
+          Value *ptr = sInst->getPointerOperand();
+          if(getIndexAddr(ptr)) slots.push_back(getFieldAddr(ptr));
+          else if(LoadInst *lInst = dyn_cast<LoadInst>(ptr)) slots = ptsToGraph[lInst];
+          for(std::vector<Value*>::iterator j = slots.begin(); j != slots.end(); j++){
+            if(indexMap.find(*j) == indexMap.end() || offsetMap.find(*j) != offsetMap.end()) continue;
+            createOffsetVar(M, *j);
+            changed = true;
           }
         }
       }
     }
   }
-  else
-  {
-    log << "Found config!\n";
-    system("./script.sh");
+}
 
-    getExternalPtsTo(mod);
+// Each enumerated access is a profiling site, named after its function, its
+// position in the function and the index it selects on
+std::map<Function*,int> siteCount;
+std::vector<std::pair<std::string,GlobalVariable*>> profSites;
+std::map<std::string,std::map<int,long long>> profile;
+
+string getSiteKey(Function *F, Value *idx){
+  string ptrName = idx->getName().str();
+  if(LoadInst *idxLoad = dyn_cast<LoadInst>(idx))
+    ptrName = idxLoad->getPointerOperand()->getName().str();
+  return F->getName().str() + ":" + std::to_string(siteCount[F]++) + ":" + ptrName;
+}
+
+// Reads the profile written by an instrumented run, one line per site and index 
+void readProfile(){
+  llvm::formatted_raw_ostream log(logFile);
+  std::ifstream infile(ProfUse.c_str());
+  if (!infile.is_open()) {
+    log << "No profile " << ProfUse << "\n";
+    return;
+  }
+  string line;
+  while(getline(infile,line)){
+    stringstream linestream(line);
+    string func,site,ptr,indexstr,countstr;
+    getline(linestream,func,':');
+    getline(linestream,site,':');
+    getline(linestream,ptr,':');
+    getline(linestream,indexstr,':');
+    getline(linestream,countstr,':');
+    long long count;
+    stringstream convert(countstr);
+    if(!(convert >> count)) continue;
+    profile[func + ":" + site + ":" + ptr][strToInt(indexstr)] += count;
   }
+  infile.close();
+  log << "Read profile for " << profile.size() << " site(s)\n";
+}
 
-  printPtsTo();
+long long getProfCount(string site, Value *val){
+  std::map<int,long long> &counts = profile[site];
+  std::map<int,long long>::iterator count = counts.find(getIndex(val));
+  return count != counts.end() ? count->second : 0;
+}
 
+// Orders a points-to set by how often each element was selected. Select chains
+// want the hot elements last, closest to the output, switches want them first.
+void orderPtsTo(string site, std::vector<Value*> &ptsToSet, bool hotFirst){
+  if(profile.find(site) == profile.end()) return;
+  std::stable_sort(ptsToSet.begin(), ptsToSet.end(), [&](Value *a, Value *b){
+      return hotFirst ? getProfCount(site, a) > getProfCount(site, b) 
+                      : getProfCount(site, a) < getProfCount(site, b);
+      });
+}
 
+// Gets the element that is selected by most of the accesses at a site, if any
+Value *getDominantTarget(string site, std::vector<Value*> &ptsToSet){
+  if(profile.find(site) == profile.end()) return NULL;
+  long long total = 0;
+  std::map<int,long long> &counts = profile[site];
+  for(std::map<int,long long>::iterator count = counts.begin(); count != counts.end(); count++)
+    total += count->second;
+  for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+    if(total > 0 && getProfCount(site, *j) * 100 >= total * ProfPeel) return *j;
+  }
+  return NULL;
+}
 
-  std::map<Value*,Value*> replaceMap;
-  std::vector<Instruction*> removalList;
+// Counts the index observed at a site in a global counter array
+void instrumentSite(IRBuilder<> &builder, string site, Value *idx){
+  Module *M = builder.GetInsertBlock()->getModule();
+  LLVMContext &c = M->getContext();
+  Type *intTy2 = TypeBuilder<int64_t,false>::get(c);
+  unsigned size = std::max(globalVarMap.size(), funcVarMap.size()) + 1;
+  ArrayType *countTy = ArrayType::get(intTy2, size);
+  GlobalVariable *counts = new GlobalVariable(*M, countTy, false, GlobalValue::InternalLinkage,
+      ConstantAggregateZero::get(countTy), "ptsToProf");
+  profSites.push_back(std::make_pair(site, counts));
+
+  Constant *sizeVal = ConstantInt::get(idx->getType(), size);
+  Constant *zero = ConstantInt::get(idx->getType(), 0);
+  Value *inRange = builder.CreateICmpULT(idx, sizeVal, "prof_range");
+  Value *slot = builder.CreateSelect(inRange, idx, zero, "prof_slot");
+  Value *gepVec[] = {zero, slot};
+  Value *countAddr = builder.CreateInBoundsGEP(counts, gepVec, "prof_addr");
+  Value *count = builder.CreateLoad(countAddr, "prof_count");
+  Value *inc = builder.CreateAdd(count, ConstantInt::get(intTy2, 1), "prof_inc");
+  builder.CreateStore(inc, countAddr);
+}
+
+// Calls a C library function through its declaration in the module, which 
+// may use other pointer types, e.g. %struct._IO_FILE* for a FILE*
+Value *createLibCall(IRBuilder<> &builder, string name, FunctionType *FTy, ArrayRef<Value*> args, string resName){
+  Module *M = builder.GetInsertBlock()->getModule();
+  M->getOrInsertFunction(name, FTy);
+  Function *fn = M->getFunction(name);
+  FunctionType *fnTy = fn->getFunctionType();
+  std::vector<Value*> callArgs;
+  for(unsigned i = 0; i < args.size(); i++){
+    Value *arg = args[i];
+    if(i < fnTy->getNumParams()) arg = builder.CreateBitOrPointerCast(arg, fnTy->getParamType(i));
+    callArgs.push_back(arg);
+  }
+  Value *call = builder.CreateCall(fn, callArgs, resName);
+  return builder.CreateBitOrPointerCast(call, FTy->getReturnType(), resName + "_cast");
+}
+
+// Writes all non-zero counters to ptsToEnum.prof when the program exits
+void emitProfileDump(Module *M){
+  LLVMContext &c = M->getContext();
+  Type *voidTy = Type::getVoidTy(c);
   Type *intTy = TypeBuilder<int,false>::get(c);
+  Type *charPtrTy = Type::getInt8PtrTy(c);
+  Type *fopenArgs[] = {charPtrTy, charPtrTy};
+  FunctionType *fopenTy = FunctionType::get(charPtrTy, fopenArgs, false);
+  FunctionType *fprintfTy = FunctionType::get(intTy, fopenArgs, true);
+  Type *fcloseArgs[] = {charPtrTy};
+  FunctionType *fcloseTy = FunctionType::get(intTy, fcloseArgs, false);
+
+  Function *dump = Function::Create(FunctionType::get(voidTy, false),
+      GlobalValue::InternalLinkage, "ptsToProfDump", M);
+  BasicBlock *entry = BasicBlock::Create(c, "entry", dump);
+  BasicBlock *write = BasicBlock::Create(c, "write", dump);
+  BasicBlock *exit = BasicBlock::Create(c, "exit", dump);
+  IRBuilder<> builder(entry);
+  Value *openArgs[] = {builder.CreateGlobalStringPtr("ptsToEnum.prof"), builder.CreateGlobalStringPtr("w")};
+  Value *file = createLibCall(builder, "fopen", fopenTy, openArgs, "file");
+  builder.CreateCondBr(builder.CreateIsNull(file), exit, write);
+
+  builder.SetInsertPoint(write);
+  Value *format = builder.CreateGlobalStringPtr("%s:%d:%lld\n");
+  for(std::vector<std::pair<std::string,GlobalVariable*>>::iterator site = profSites.begin(); site != profSites.end(); site++){
+    Value *siteName = builder.CreateGlobalStringPtr(site->first);
+    unsigned size = site->second->getType()->getContainedType(0)->getArrayNumElements();
+    for(unsigned i = 0; i < size; i++){
+      // Skipping indices that were never observed
+      Value *gepVec[] = {ConstantInt::get(intTy, 0), ConstantInt::get(intTy, i)};
+      Value *count = builder.CreateLoad(builder.CreateInBoundsGEP(site->second, gepVec), "count");
+      BasicBlock *print = BasicBlock::Create(c, "print", dump, exit);
+      BasicBlock *next = BasicBlock::Create(c, "next", dump, exit);
+      builder.CreateCondBr(builder.CreateIsNull(count), next, print);
+      builder.SetInsertPoint(print);
+      Value *printArgs[] = {file, format, siteName, ConstantInt::get(intTy, i), count};
+      createLibCall(builder, "fprintf", fprintfTy, printArgs, "printed");
+      builder.CreateBr(next);
+      builder.SetInsertPoint(next);
+    }
+  }
+  Value *closeArgs[] = {file};
+  createLibCall(builder, "fclose", fcloseTy, closeArgs, "closed");
+  builder.CreateBr(exit);
+  builder.SetInsertPoint(exit);
+  builder.CreateRetVoid();
+  appendToGlobalDtors(*M, dump, 0);
+}
 
-  // Handle direct loads and stores to double pointers! 
-  for(Module::iterator F = mod->begin(); F != mod->end(); F++){
-    for(Function::iterator BB = F->begin(); BB != F->end(); BB++){
-      for (Function::arg_iterator arg = F->arg_begin(); arg != F->arg_end(); arg++) {
-        getExternalPtsToForArgs(&(*arg));
-      }
-      for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++){
-        // Setting insertion point.
-        IRBuilder<> builder(I->getParent());
-        builder.SetInsertPoint(&(*I));
-
-        // Load instructions
-        log << "Instr: " << *I << "\n";
-        if(LoadInst *lInst = dyn_cast<LoadInst>(I)){
-          log << "Found load: " << *lInst << "\n";
-          // if address is in indexmap, then it is a direct access to a global 
-          std::map<Value*,Value*>::iterator it = indexMap.find(lInst->getPointerOperand());
-          if (it != indexMap.end()) {
-            instCount++;
-            // Simply replace the pointer-based load with a integer-based load
-            Value *oldLoad = it->second; 
-            Value *newLoad = builder.CreateLoad(oldLoad, true, oldLoad->getName().str() + "_load");
-            log << "Direct load:" << *newLoad << "\n";
-
-            // House-keeping for replacing and removing redundant loads 
-            replaceMap.insert(std::pair<Value*, Value*>(lInst,newLoad));
-            removalList.push_back(lInst);
-            ptsCount++;
-          } else {
-            if(LoadInst *load = dyn_cast<LoadInst>(lInst->getPointerOperand())){
-              log << "Found indirect load: " << *load << "\n";
-              // All indirect addresses are in the replacement map 
-              Value *addrCompLoad;
-              std::map<Value*,Value*>::iterator base = replaceMap.find(load);
-              if (base != replaceMap.end()) {
-                // Get the replacement load 
-                log << "Replacement load: " << *base->second << "\n";
-                addrCompLoad = base->second;
-              }
+// Compares built on an index, hoisted and shared once the lowering is done
+std::set<Value*> decodeCmps;
 
-              // Get points-to set for the load instruction 
-              // This set can be the entire set of globals or an external input.  
-
-              std::vector<Value*> ptsToSet = ptsToGraph[load];
-              Value *prevLoad, *currLoad, *currCmp, *currSelect; 
-              log << "ptsTo size: " << ptsToSet.size() << "\n";
-              instCount++;
-
-              int iteration = 0;
-              for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
-                // Get address of points-to element, including if it is a pointer
-                // If it is a pointer, the element is in the indexMap
-                std::map<Value*,Value*>::iterator addrIt = indexMap.find(*j);
-                Value *addr; 
-                if (addrIt != indexMap.end()) addr = addrIt->second;
-                else addr = *j;
-
-                if(addr->getType()->getContainedType(0)->isAggregateType()) continue;
-
-                log << "Value " << *addr << "\n";
-
-                // Skip if the two variables are the same!
-                if(LoadInst *ld = dyn_cast<LoadInst>(addrCompLoad))
-                  if(ld->getPointerOperand()==addr) continue;
-
-                ptsCount++;
-                // Get relative distance of current element in points-to set
-                //int dist = std::distance(ptsToSet.begin(),
-                //    std::find(ptsToSet.begin(), ptsToSet.end(), &(**j)));
-
-                if(iteration==0){
-                  // Create the first load in the points-to set
-                  prevLoad = builder.CreateLoad(addr, true, addr->getName().str() + "_load");
-                  log << "currLoad " << *prevLoad << "\n";
-                  //break;
-                  iteration++;
-                  continue;
-                }
-                iteration++;
+// Checks whether a global holds the index of a pointer or the indices of a 
+// pointer table
+bool isIndexGlobal(Value *addr){
+  for(std::map<Value*,Value*>::iterator v = indexMap.begin(); v != indexMap.end(); v++)
+    if(v->second==addr) return true;
+  return false;
+}
 
-                // For all points-to elements, create a load, get current index,
-                // compare the index and finally add select statement
-                currLoad = builder.CreateLoad(addr, true, addr->getName().str() + "_load");
-                Constant *index = ConstantInt::get(intTy, getIndex(*j), true);
-                Value *idxVal = dyn_cast<Value>(index);
-                currCmp = builder.CreateICmpEQ(idxVal, addrCompLoad, 
-                    addr->getName().str() + "_cmp");
-                currSelect = builder.CreateSelect(currCmp,currLoad, prevLoad,
-                    addr->getName().str() + "_select");
-                prevLoad = currSelect;
-
-                log << "prevLoad" << *prevLoad << "\n";
-                log << "currLoad" << *currLoad << "\n";
-                log << "currCmp" << *currCmp << "\n";
-                log << "currSelect" << *currSelect << "\n";
-              }
+// Checks whether an address is an index or offset global of a pointer
+bool isIndexVar(Value *addr){
+  if(isIndexGlobal(addr)) return true;
+  for(std::map<Value*,Value*>::iterator v = offsetMap.begin(); v != offsetMap.end(); v++)
+    if(v->second==addr) return true;
+  return false;
+}
 
-              // House-keeping replacing and removing loads 
-              if(ptsToSet.size()>0){
-                log << "Pushed replacement map\n";
-                log << *lInst << " to " << *prevLoad << "\n";
-                replaceMap.insert(std::pair<Value*, Value*>(lInst,prevLoad));
-                removalList.push_back(lInst);
-              }
-            }
-            else if(GetElementPtrInst *gepInst = dyn_cast<GetElementPtrInst>(lInst->getPointerOperand())){
-              log << "Found an indirect GEP: " << *gepInst << "\n";
-              Instruction *pts = dyn_cast<Instruction>(gepInst);
-              std::vector<Value*> ptsToSet = ptsToGraph[pts];
-              log << "that points to " << ptsToSet.size() << " object(s)\n";
-              if(gepInst->getNumIndices()>1) continue;
-              for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
-                log << "gepVec: " << **ind_begin << "\n";
-              }
+// Loads of program data are volatile. Index and offset globals are only 
+// written by the stores we emit, so their loads are plain and can be shared 
+// and hoisted.
+Value *createLoad(IRBuilder<> &builder, Value *addr, string name){
+  return builder.CreateLoad(addr, !isIndexVar(addr), name);
+}
 
-              Value* addrCompGep = gepInst->getPointerOperand();
-              std::map<Value*,Value*>::iterator base = replaceMap.find(gepInst->getPointerOperand());
-              if (base != replaceMap.end()) {
-                // Get the replacement store
-                log << "Replacement load: " << *base->second << "\n";
-                addrCompGep = base->second;
-              }
+// Compares an index against the index of a points-to element
+Value *createIndexCmp(IRBuilder<> &builder, Value *idx, Value *obj, string name){
+  Constant *index = ConstantInt::get(idx->getType(), getIndex(obj), true);
+  Value *cmp = builder.CreateICmpEQ(idx, index, name);
+  decodeCmps.insert(cmp);
+  return cmp;
+}
 
-              Value *repInst;
-              instCount++;
-
-              int iteration = 0;
-
-              for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
-                // Get address of points-to element, including if it is a pointer
-                // If it is a pointer, the element is in the indexMap
-                //std::map<Value*,Value*>::iterator addrIt = indexMap.find(*j);
-                Value *addr; 
-                //if (addrIt != indexMap.end()) addr = addrIt->second;
-                //else 
-                addr = *j;
-
-                log << "Value " << *addr << "\n";
-                if(!addr->getType()->getContainedType(0)->isAggregateType()) continue;
-                log << "Proceeding!\n";
-                ptsCount++;
-
-                Type *intTy2 = TypeBuilder<int64_t,false>::get(c);
-                Constant *zero32 = ConstantInt::get(intTy, 0, true);
-                Constant *zero64 = ConstantInt::get(intTy2, 0, true);
-                vector<Value*> gepVec;
-
-                log << "Num of indices " << gepInst->getNumIndices() << "\n";
-                for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
-                  if(Instruction *indInst = dyn_cast<Instruction>(*ind_begin)){
-                    log << "Found indice that is an instruction: " << **ind_begin << "\n";
-                    gepVec.push_back(zero32);
-                  }else
-                    gepVec.push_back(zero64);
-                }
+// Guards the lowering of an access, emitted between first and at, with a 
+// compare against its dominant target. The dominant target is accessed 
+// directly and everything else goes through the lowering.
+Value *peelAccess(Instruction *first, Instruction *at, Value *idx, Value *hot,
+    std::function<Value*(IRBuilder<>&)> direct, Value *lowered, string name){
+  llvm::formatted_raw_ostream log(logFile);
+  if(first==at) return lowered;
+  LLVMContext &c = at->getContext();
+  BasicBlock *head = first->getParent();
+  Function *F = head->getParent();
+  BasicBlock *lowerBB = head->splitBasicBlock(first, name + "_lowered");
+  BasicBlock *tail = lowerBB->splitBasicBlock(at, name + "_merge");
+  BasicBlock *directBB = BasicBlock::Create(c, name + "_direct", F, lowerBB);
+  Instruction *br = BranchInst::Create(tail, directBB);
+
+  IRBuilder<> builder(head->getTerminator());
+  Value *peelCmp = createIndexCmp(builder, idx, hot, name + "_peel");
+  builder.CreateCondBr(peelCmp, directBB, lowerBB);
+  head->getTerminator()->eraseFromParent();
+
+  builder.SetInsertPoint(br);
+  Value *directVal = direct(builder);
+  log << "Peeled " << hot->getName() << " with " << *peelCmp << "\n";
+  if(!lowered) return NULL;
+  PHINode *phi = PHINode::Create(lowered->getType(), 2, name + "_phi", at);
+  phi->addIncoming(directVal, directBB);
+  phi->addIncoming(lowered, lowerBB);
+  return phi;
+}
 
-                for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
-                  gepVec.push_back(*ind_begin);
-                }
+// Copies the address of an access for use on the peeled path
+Value *cloneAddr(IRBuilder<> &builder, Value *addr){
+  Instruction *addrInst = dyn_cast<Instruction>(addr);
+  if(!addrInst) return addr;
+  Instruction *newAddr = addrInst->clone();
+  builder.Insert(newAddr, addrInst->getName().str() + "_direct");
+  return newAddr;
+}
 
-                ArrayRef<Value*> gepAR(gepVec);
-
-                log << "Addr is " << *addr << "\n";
-                Value *newGep;
-                newGep = builder.CreateInBoundsGEP(addr, gepAR, gepInst->getName().str() + addr->getName().str() + "_gep");
-                //Value *newGep = builder.CreateInBoundsGEP(addr, gepAR, addr->getName().str() + "_gep");
-                log << "New GEP generated!\n";
-                log << *newGep << "\n";
-                Value * currLoad = builder.CreateLoad(newGep, true, gepInst->getName().str() + addr->getName().str() + "_load");
-                log << "CurrLoad: " << *currLoad << "\n";
-                // Get relative distance of current element in points-to set
-                //int dist = std::distance(ptsToSet.begin(),
-                //    std::find(ptsToSet.begin(), ptsToSet.end(), &(**j)));
-
-                if(iteration==0){
-                  repInst = currLoad; 
-                  iteration++;
-                  continue;
-                }
-                  iteration++;
-
-                Constant *index = ConstantInt::get(intTy, getIndex(addr), true);
-                Value *idxVal = dyn_cast<Value>(index);
-                Value *currCmp    = builder.CreateICmpEQ(addrCompGep, idxVal, gepInst->getName().str() +
-                    addr->getName().str() + "_cmp");
-                log << "CurrCmp: " << *currCmp << "\n";
-                Value *currSelect = builder.CreateSelect(currCmp, currLoad, repInst, gepInst->getName().str() + 
-                    addr->getName().str() + "_select");
-                repInst = currSelect;
-                log << "CurrSelect: " << *currSelect << "\n";
-              }
-              if(ptsToSet.size()>0){
-                log << "Replacing: \n";
-                log << *lInst << " with \n";
-                log << *repInst << "\n";
-                replaceMap.insert(std::pair<Value*, Value*>(lInst,repInst));
-                removalList.push_back(lInst);
-                //removalList.push_back(gepInst);
-              }
-            }
-            else {
-              instCount++;
-              ptsCount++;
-            }
-          }
-        }
+typedef std::function<Value*(IRBuilder<>&, Value*)> CaseBodyFn;
 
-        // Store instructions 
-        if(StoreInst *sInst = dyn_cast<StoreInst>(I)){
-          log << "Store: " << *sInst << "\n";
-          log << "operand 0: " << *sInst->getOperand(0) << "\n";
-          log << "operand 1: " << *sInst->getOperand(1) << "\n";
-          std::map<Value*,Value*>::iterator it = indexMap.find(sInst->getPointerOperand());
-          if (it != indexMap.end()) {
-            instCount++;
-            int in;
-            if(Argument *arg = dyn_cast<Argument>(sInst->getOperand(0))){
-              log << "Argument spotted: "<< *arg <<"\n";
-              in = getIndex(*argsPtsToGraph[arg].begin());
-            }
-            if(GEPOperator *gepOp = dyn_cast<GEPOperator>(sInst->getOperand(0)))
-            {
-              log << "Found GEP: " << *gepOp << "\n";
-              log << "Found Address: " << *gepOp->getPointerOperand() << "\n";
-              in = getIndex(gepOp->getPointerOperand());
-            }else{
-              in = getIndex(sInst->getOperand(0));
-            }
-            log << "Index is " << in << "\n";
-            Constant *index = ConstantInt::get(intTy, in, true);
-            Value *indexVal = dyn_cast<Value>(index);
-            Value *addrVal = it->second; 
-            if(in==0){
-              std::map<Value*,Value*>::iterator base = replaceMap.find(sInst->getOperand(0));
-              if (base != replaceMap.end()) {
-                // Get the replacement store
-                log << "Replacement load: " << *base->second << "\n";
-                indexVal = base->second;
-              }
-            }
-            Value *newStore = builder.CreateStore(indexVal, addrVal, true);
-            log << "Injecting store " << *newStore << "\n";
-            removalList.push_back(sInst);
-            ptsCount++;
-          }
-          else{
-            if(LoadInst* lInst = dyn_cast<LoadInst>(sInst->getPointerOperand())){
-              log << "Found indirect load: " << *lInst << "\n";
-              // All indirect addresses are in the replacement map 
-              Value *addrCompLoad;
-              std::map<Value*,Value*>::iterator base = replaceMap.find(lInst);
-              if (base != replaceMap.end()) {
-                // Get the replacement store
-                log << "Replacement load: " << *base->second << "\n";
-                addrCompLoad = base->second;
-              }
+// Lowers a selection on an index into a switch with one block per points-to
+// element. The body is emitted in each case block and the results are merged
+// with a phi. As for the select chains, the first element is the default. 
+// The builder is left in front of the instruction it was pointing at.
+Value *emitIndexSwitch(IRBuilder<> &builder, Value *idx, std::vector<Value*> &ptsToSet,
+    CaseBodyFn body, Type *resTy, std::string name){
+  llvm::formatted_raw_ostream log(logFile);
+  if(ptsToSet.size()==0) return NULL;
+  // Nothing to select from
+  if(ptsToSet.size()==1) return body(builder, ptsToSet[0]);
+
+  Instruction *at = &(*builder.GetInsertPoint());
+  BasicBlock *head = at->getParent();
+  Function *F = head->getParent();
+  BasicBlock *tail = head->splitBasicBlock(at, name + "_merge");
+  head->getTerminator()->eraseFromParent();
+
+  PHINode *phi = NULL;
+  if(!resTy->isVoidTy())
+    phi = PHINode::Create(resTy, ptsToSet.size(), name + "_phi", at);
+
+  SwitchInst *sw = NULL;
+  for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+    BasicBlock *caseBB = BasicBlock::Create(F->getContext(), 
+        name + "_" + getObjName(*j), F, tail);
+    Instruction *br = BranchInst::Create(tail, caseBB);
+    builder.SetInsertPoint(br);
+    Value *caseVal = body(builder, *j);
+    if(phi) phi->addIncoming(caseVal, builder.GetInsertBlock());
+
+    if(sw==NULL){
+      builder.SetInsertPoint(head);
+      sw = builder.CreateSwitch(idx, caseBB, ptsToSet.size()-1);
+      log << "Switch " << *sw << "\n";
+      continue;
+    }
+    ConstantInt *caseIdx = ConstantInt::get(dyn_cast<IntegerType>(idx->getType()), getIndex(*j), true);
+    sw->addCase(caseIdx, caseBB);
+    log << "Case " << *caseIdx << " to " << caseBB->getName() << "\n";
+  }
 
-              // Get points-to set for the load instruction 
-              // This set can be the entire set of globals or an external input.  
-              std::vector<Value*> ptsToSet = ptsToGraph[lInst];
-              instCount++;
-              log << "ptsToSet size is " << ptsToSet.size() << "\n";
-              
-              for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
-                // Get address of points-to element, including if it is a pointer
-                // If it is a pointer, the element is in the indexMap
-                std::map<Value*,Value*>::iterator addrIt = indexMap.find(*j);
-                Value *addr; 
-                if (addrIt != indexMap.end()) addr = addrIt->second;
-                else addr = *j;
-
-                if(addr->getType()->getContainedType(0)->isAggregateType()) continue;
-                log << "Value " << *addr << "\n";
-
-                ptsCount++;
-                // Skip if the two variables are the same!
-                if(LoadInst *addrCompInst = dyn_cast<LoadInst>(addrCompLoad))
-                  if(addrCompInst->getPointerOperand()==addr) continue;
-
-                // Get index if store value itself is a pointer  
-                Value *s1 = sInst->getOperand(0);
-                int index = getIndex(sInst->getOperand(0));
-                log << "Index is " << index << "\n";
-                if(/*isDoublePtr(s1) &&*/ index>0){
-                  Constant *sIndex = ConstantInt::get(intTy, getIndex(sInst->getOperand(0)), true);
-                  s1 = dyn_cast<Value>(sIndex);
-                }else{
-                  std::map<Value*,Value*>::iterator base = replaceMap.find(sInst->getOperand(0));
-                  if (base != replaceMap.end()) {
-                    // Get the replacement store
-                    log << "Replacement load: " << *base->second << "\n";
-                    s1 = base->second;
-                  }
-                }
+  builder.SetInsertPoint(at);
+  return phi;
+}
 
-                log << "s1: " << *s1 << "\n";
-
-                if(ptsToSet.size()==1){
-                  Value *currStore  = builder.CreateStore(s1, addr, true);
-                  log << "currStore" << *currStore  << "\n";
-                  break;
-                }else{
-                  Value *currLoad = builder.CreateLoad(addr, true, sInst->getName().str() + addr->getName().str() + "_load");
-                  log << "currLoad" << *currLoad << "\n";
-                  Constant *index = ConstantInt::get(intTy, getIndex(*j), true);
-                  Value *idxVal = dyn_cast<Value>(index);
-                  Value *currCmp    = builder.CreateICmpEQ(addrCompLoad, idxVal, 
-                      sInst->getName().str() + addr->getName().str() + "_cmp");
-                  log << "currCmp" << *currCmp << "\n";
-                  Value *currSelect = builder.CreateSelect(currCmp, s1, currLoad,
-                      sInst->getName().str() + addr->getName().str() + "_select");
-                  log << "currSelect" << *currSelect  << "\n";
-                  Value *currStore  = builder.CreateStore(currSelect, addr, true);
-                  log << "currStore" << *currStore  << "\n";
-                }
-              }
-              if(ptsToSet.size()>0) removalList.push_back(sInst);
-            } 
-            else if(GetElementPtrInst* gepInst = dyn_cast<GetElementPtrInst>(sInst->getPointerOperand())){
-              log << "Found indirect GEP: " << *gepInst << "\n";
-              for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
-                log << "gepVec: " << **ind_begin << "\n";
-              }
-              if(gepInst->getNumIndices()>1) continue;
-              // All indirect addresses are in the replacement map 
-              Value *addrCompLoad ; //= gepInst->getPointerOperand();
-              std::map<Value*,Value*>::iterator base = replaceMap.find(gepInst->getPointerOperand());
-              if (base != replaceMap.end()) {
-                // Get the replacement store
-                log << "Replacement load: " << *base->second << "\n";
-                addrCompLoad = base->second;
-              }
+// Gets the address of a points-to element as a pointer of type ptrTy. Arrays
+// decay to their first element as they would in C.
+Value *decayAddr(IRBuilder<> &builder, Value *addr, Type *ptrTy){
+  Type *intTy = TypeBuilder<int,false>::get(builder.getContext());
+  Constant *zero32 = ConstantInt::get(intTy, 0, true);
+  while(addr->getType()!=ptrTy && addr->getType()->getContainedType(0)->isArrayTy()){
+    Value *idx[] = {zero32, zero32};
+    addr = builder.CreateInBoundsGEP(addr, idx, getObjName(addr) + "_decay");
+  }
+  if(addr->getType()!=ptrTy)
+    addr = builder.CreatePointerCast(addr, ptrTy, getObjName(addr) + "_cast");
+  return addr;
+}
 
-              // Get points-to set for the load instruction 
-              // This set can be the entire set of globals or an external input.  
-              std::vector<Value*> ptsToSet = ptsToGraph[gepInst];
-              instCount++;
-              for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
-                // Get address of points-to element, including if it is a pointer
-                // If it is a pointer, the element is in the indexMap
-                Value *addr;
-                addr = *j;
-
-                log << "Value " << *addr << "\n";
-                if(!addr->getType()->getContainedType(0)->isAggregateType()) continue;
-                log << "Proceeding!\n";
-                ptsCount++;
-
-                Value *s1;
-                std::map<Value*,Value*>::iterator base = replaceMap.find(sInst->getOperand(0));
-                if (base != replaceMap.end()) {
-                  // Get the replacement store
-                  log << "Replacement load: " << *base->second << "\n";
-                  s1 = base->second;
-                } else {
-                  s1 = sInst->getOperand(0);
-                }
+// Gets the element at offset off of an array points-to element
+Value *offsetAddr(IRBuilder<> &builder, Value *addr, Value *off, Type *elemTy){
+  Value *elem = decayAddr(builder, addr, elemTy->getPointerTo());
+  if(!off) return elem;
+  return builder.CreateInBoundsGEP(elem, off, getObjName(addr) + "_off");
+}
 
-                Type *intTy2 = TypeBuilder<int64_t,false>::get(c);
-                Constant *zero32 = ConstantInt::get(intTy, 0, true);
-                Constant *zero64 = ConstantInt::get(intTy2, 0, true);
-                vector<Value*> gepVec;
-
-                log << "Num of indices " << gepInst->getNumIndices() << "\n";
-                for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
-                  if(Instruction *indInst = dyn_cast<Instruction>(*ind_begin)){
-                    log << "Found indice that is an instruction: " << **ind_begin << "\n";
-                    gepVec.push_back(zero32);
-                  } else
-                    gepVec.push_back(zero64);
-                }
+// Gets the element of an array points-to element that an access of type 
+// accessTy reaches, NULL if the access does not fit the array. Pointer tables
+// are accessed through their index table.
+Value *getElemAddr(IRBuilder<> &builder, Value *obj, Value *addr, Value *off, Type *accessTy){
+  Type *elemTy = accessTy;
+  if(isPtrTable(obj)){
+    if(!decaysTo(obj, accessTy)) return NULL;
+    elemTy = TypeBuilder<int,false>::get(builder.getContext());
+  }
+  if(!decaysTo(addr, elemTy)) return NULL;
+  return offsetAddr(builder, addr, off, elemTy);
+}
 
-                for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
-                  gepVec.push_back(*ind_begin);
-                }
+// Rebuilds the casts and GEPs between an enumerated pointer and its use on top 
+// of one points-to element. The offset of the pointer, if any, goes into the 
+// first index.
+Value *rebaseAddr(IRBuilder<> &builder, Value *ptr, Value *base, Value *addr, Value *off = NULL){
+  if(ptr==base){
+    if(off) return offsetAddr(builder, addr, off, base->getType()->getContainedType(0));
+    return decayAddr(builder, addr, base->getType());
+  }
+  if(BitCastInst *cast = dyn_cast<BitCastInst>(ptr)){
+    Value *op = rebaseAddr(builder, cast->getOperand(0), base, addr, off);
+    return builder.CreateBitCast(op, cast->getType(), cast->getName().str() + getObjName(addr));
+  }
+  GetElementPtrInst *gepInst = dyn_cast<GetElementPtrInst>(ptr);
+  assert(gepInst && "Unexpected address computation");
+  vector<Value*> gepVec;
+  Value *op = addr;
+  // Indexing straight into an array element instead of decaying first
+  Type *ty = addr->getType()->getContainedType(0);
+  if(gepInst->getPointerOperand()==base){
+    Constant *zero = Constant::getNullValue((*gepInst->idx_begin())->getType());
+    while(ty != gepInst->getSourceElementType() && ty->isArrayTy()){
+      gepVec.push_back(zero);
+      ty = ty->getArrayElementType();
+    }
+  }
+  if(ty != gepInst->getSourceElementType() || gepInst->getPointerOperand()!=base){
+    gepVec.clear();
+    op = rebaseAddr(builder, gepInst->getPointerOperand(), base, addr, off);
+    off = NULL;
+  }
+  gepVec.insert(gepVec.end(), gepInst->idx_begin(), gepInst->idx_end());
+  if(off){
+    Value *&first = gepVec[gepVec.size() - gepInst->getNumIndices()];
+    first = builder.CreateAdd(builder.CreateSExtOrTrunc(off, first->getType()), first,
+        gepInst->getName().str() + getObjName(addr) + "_off");
+  }
+  return builder.CreateInBoundsGEP(op, gepVec, gepInst->getName().str() + getObjName(addr) + "_gep");
+}
 
-                ArrayRef<Value*> gepAR(gepVec);
+// Finds the enumerated pointer behind the casts and GEPs of an address
+Value *getEnumeratedBase(Value *ptr, std::map<Value*,Value*> &replaceMap){
+  while(true){
+    if(replaceMap.find(ptr) != replaceMap.end()) return ptr;
+    if(BitCastInst *cast = dyn_cast<BitCastInst>(ptr)) ptr = cast->getOperand(0);
+    else if(GetElementPtrInst *gepInst = dyn_cast<GetElementPtrInst>(ptr)) ptr = gepInst->getPointerOperand();
+    else return NULL;
+  }
+}
 
-                log << "Addr is " << *addr << "\n";
-                Value *newGep;
-                newGep = builder.CreateInBoundsGEP(addr, gepAR, gepInst->getName().str() + addr->getName().str() + "_gep");
+// Gets the index of a pointer, pointers to known objects are their index and
+// enumerated pointers have a replacement. NULL if there is no index.
+Value *getIndexValue(Value *val, std::map<Value*,Value*> &replaceMap){
+  llvm::formatted_raw_ostream log(logFile);
+  if(isa<ConstantPointerNull>(val))
+    return ConstantInt::get(TypeBuilder<int,false>::get(val->getContext()), nullIndex, true);
+  int index = getIndex(getObject(val));
+  log << "Index is " << index << "\n";
+  if(val->getType()->isPointerTy() && index>0)
+    return ConstantInt::get(TypeBuilder<int,false>::get(val->getContext()), index, true);
+  // Pointer arithmetic keeps the index of the pointer it starts from
+  std::map<Value*,Value*>::iterator base = replaceMap.find(val);
+  if (base == replaceMap.end()) base = replaceMap.find(getObject(val));
+  if (base != replaceMap.end()) {
+    log << "Replacement load: " << *base->second << "\n";
+    return base->second;
+  }
+  return NULL;
+}
 
-                log << "New GEP: " << *newGep << "\n";
-                log << "Value " << *addr << "\n";
+// Gets the value to store through an enumerated pointer, pointers are stored 
+// as their index
+Value *getStoreValue(Value *val, std::map<Value*,Value*> &replaceMap){
+  Value *index = getIndexValue(val, replaceMap);
+  if(index) return index;
+  if(val->getType()->isPointerTy())
+    return ConstantInt::get(TypeBuilder<int,false>::get(val->getContext()), unknownIndex, true);
+  return val;
+}
 
-                // Get index if store value itself is a pointer  
-                if(ptsToSet.size()==1){
-                  Value *currStore  = builder.CreateStore(sInst->getOperand(0), newGep, true);
-                  log << "currStore" << *currStore  << "\n";
-                  break;
-                }
-                Value *currLoad = builder.CreateLoad(newGep, true, gepInst->getName().str() + addr->getName().str() + "_load");
-                log << "currLoad" << *currLoad << "\n";
-                int ind = getIndex(addr);
-                Constant *index = ConstantInt::get(intTy, ind, true);
-                Value *idxVal = dyn_cast<Value>(index);
-                Value *currCmp    = builder.CreateICmpEQ(addrCompLoad, idxVal, 
-                    gepInst->getName().str() + addr->getName().str() + "_cmp");
-                log << "currCmp" << *currCmp << "\n";
-                Value *currSelect = builder.CreateSelect(currCmp, s1, currLoad,
-                    gepInst->getName().str() + addr->getName().str() + "_select");
-                log << "currSelect" << *currSelect << "\n";
-                Value *currStore  = builder.CreateStore(currSelect, newGep, true);
-                log << "currStore" << *currStore  << "\n";
-              }
-              if(ptsToSet.size()>0) {
-                //removalList.push_back(gepInst);
-                removalList.push_back(sInst);
-              }
-            }
-            else {
-              instCount++;
-              ptsCount++;
-            }
-          }
-        }
-      }
+// Selects the offset of a pointer read through an enumerated pointer. Each 
+// slot pairs a points-to element with the pointer it holds.
+Value *selectOffset(IRBuilder<> &builder, Value *idx, 
+    std::vector<std::pair<Value*,Value*>> &slots, string name){
+  Type *intTy = TypeBuilder<int,false>::get(builder.getContext());
+  Value *off = ConstantInt::get(intTy, 0);
+  bool fat = false;
+  for(std::vector<std::pair<Value*,Value*>>::iterator j = slots.begin(); j != slots.end(); j++){
+    Value *offAddr = getOffsetAddr(j->second);
+    if(!offAddr) continue;
+    fat = true;
+    Value *offLoad = createLoad(builder, offAddr, offAddr->getName().str() + "_load");
+    if(slots.size()==1) return offLoad;
+    Value *offCmp = createIndexCmp(builder, idx, j->first, name + getObjName(j->first) + "_offcmp");
+    off = builder.CreateSelect(offCmp, offLoad, off, name + getObjName(j->first) + "_offselect");
+  }
+  if(!fat) return NULL;
+  return off;
+}
+
+// Writes the offset of a pointer stored through an enumerated pointer to the
+// slots that carry one
+void storeOffset(IRBuilder<> &builder, Value *idx, 
+    std::vector<std::pair<Value*,Value*>> &slots, Value *off, string name){
+  Type *intTy = TypeBuilder<int,false>::get(builder.getContext());
+  if(!off) off = ConstantInt::get(intTy, 0);
+  for(std::vector<std::pair<Value*,Value*>>::iterator j = slots.begin(); j != slots.end(); j++){
+    Value *offAddr = getOffsetAddr(j->second);
+    if(!offAddr) continue;
+    Value *newOff = off;
+    if(slots.size()>1){
+      Value *offLoad = createLoad(builder, offAddr, offAddr->getName().str() + "_load");
+      Value *offCmp = createIndexCmp(builder, idx, j->first, name + getObjName(j->first) + "_offcmp");
+      newOff = builder.CreateSelect(offCmp, off, offLoad, name + getObjName(j->first) + "_offselect");
     }
+    builder.CreateStore(newOff, offAddr, true);
   }
+}
 
-  // replacing all loads and stores that are now redundant 
-  for(std::map<Value*,Value*>::reverse_iterator map = replaceMap.rbegin(); map != replaceMap.rend(); map++){
-    log << "Replacement block\n";
-    log << "Use of: " << *map->first << "\n";
-    log << "Repl use by: " << *map->second << "\n";
-    for (auto &U : map->first->uses()) {
-      User *user = U.getUser();  // A User is anything with operands.
-      Instruction *u = dyn_cast<Instruction>(user);
-      log << "User: " << *u << "\n";
-      if(isa<GetElementPtrInst>(u)||isa<LoadInst>(u)) {
-        //removalList.push_back(u);
-        continue;
-      }
-      if(StoreInst *sInst = dyn_cast<StoreInst>(u)){
-        if(U.getOperandNo()==0 && map->second!=u->getOperand(0)){
-          log << "Replacing Store value: " << *u << "\n";
-          user->setOperand(U.getOperandNo(), map->second);
-          log << "with\n" << *user << "\n";
-        }
-        continue;
-      }
-      if(map->second==u->getOperand(U.getOperandNo()))
-        continue;
-      /*
-      // Checkign the ICmpInst and replace operand of NULL checks... 
-      if(isa<ICmpInst>(u)){
-      if(isDoublePtr(u->getOperand(1))){
-      Constant *compInt = ConstantInt::get(intTy, getIndex(u->getOperand(1)), true);
-      Value *compVal = dyn_cast<Value>(compInt);
-      user->setOperand(1, compVal);
-      }
-      continue;
-      }
-      */
+// Removes the casts and GEPs left behind by a rewritten address, the 
+// enumerated pointer itself is removed with the rest of the loads
+void removeDeadAddr(Value *ptr, Value *base){
+  while(ptr!=base){
+    Instruction *inst = dyn_cast<Instruction>(ptr);
+    if(!inst || !inst->use_empty()) return;
+    ptr = inst->getOperand(0);
+    inst->eraseFromParent();
+  }
+}
 
-      log << "Replacing User: " << *u << "\n";
-      user->setOperand(U.getOperandNo(), map->second);
+// Gets the slot a pointer stored at ptr is enumerated under, a pointer table
+// is a single slot
+Value *getSlot(Value *ptr){
+  Value *field = getFieldAddr(ptr);
+  if(indexMap.find(field) != indexMap.end()) return field;
+  GEPOperator *gepOp = dyn_cast<GEPOperator>(ptr);
+  if(!gepOp || !ptr->getType()->getContainedType(0)->isPointerTy()) return NULL;
+  Value *tbl = gepOp->getPointerOperand();
+  if(indexMap.find(tbl) == indexMap.end() || !isPtrTable(tbl)) return NULL;
+  return tbl;
+}
+
+// Finds the slots an access at addr can read or write, the slot itself for a
+// direct access, otherwise the slots among its targets and their fields
+void getAccessSlots(Value *addr, std::set<Value*> &slots){
+  if(Value *slot = getSlot(addr)){
+    slots.insert(slot);
+    return;
+  }
+  Instruction *base = dyn_cast<Instruction>(addr);
+  if(!base || ptsToGraph.find(base) == ptsToGraph.end()) return;
+  std::vector<Value*> &ptsToSet = ptsToGraph[base];
+  for(std::vector<Value*>::iterator j = ptsToSet.begin(); j != ptsToSet.end(); j++){
+    for(std::map<Value*,Value*>::iterator s = indexMap.begin(); s != indexMap.end(); s++){
+      GEPOperator *field = dyn_cast<GEPOperator>(s->first);
+      if(s->first == *j || (field && field->getPointerOperand() == *j)) slots.insert(s->first);
+    }
+  }
+}
+
+// Checks whether a pointer is still read as a pointer once the lowering is 
+// done, by anything that was left alone, e.g. a store whose targets are all
+// read-only, a memset too long for its targets or an indirect call without
+// candidates, or by an instruction that is kept, directly or through casts 
+// and GEPs
+bool hasRawUse(Instruction *I, std::set<Instruction*> &removed, std::set<Instruction*> &kept){
+  for(auto user : I->users()){
+    Instruction *u = dyn_cast<Instruction>(user);
+    if(!u) continue;
+    if(kept.find(u) != kept.end()) return true;
+    if(removed.find(u) != removed.end()) continue;
+    if(!isa<GetElementPtrInst>(u) && !isa<BitCastInst>(u)) return true;
+    if(hasRawUse(u, removed, kept)) return true;
+  }
+  return false;
+}
+
+// Pointers that are still read as pointers keep their loads, and the slots 
+// they can be read from keep their pointer stores next to the index stores,
+// so the pointer never falls behind its index. Kept stores need their address
+// and value in turn, so we go until nothing changes.
+void findKeptPtrs(std::vector<Instruction*> &removalList, std::vector<Instruction*> &mergeList,
+    std::set<Instruction*> &kept){
+  llvm::formatted_raw_ostream log(logFile);
+  std::vector<Instruction*> candidates(removalList);
+  candidates.insert(candidates.end(), mergeList.begin(), mergeList.end());
+  std::set<Instruction*> removed(candidates.begin(), candidates.end());
+  std::set<Value*> rawSlots;
+  bool changed = true;
+  while(changed){
+    changed = false;
+    for(std::vector<Instruction*>::iterator I = candidates.begin(); I != candidates.end(); I++){
+      if(kept.find(*I) != kept.end()) continue;
+      if(StoreInst *sInst = dyn_cast<StoreInst>(*I)){
+        std::set<Value*> slots;
+        getAccessSlots(sInst->getPointerOperand(), slots);
+        bool raw = false;
+        for(std::set<Value*>::iterator s = slots.begin(); s != slots.end(); s++)
+          if(rawSlots.find(*s) != rawSlots.end()) raw = true;
+        if(!raw) continue;
+      }
+      else if(!(*I)->getType()->isPointerTy() || !hasRawUse(*I, removed, kept)) continue;
+      log << "Keeping pointer: " << **I << "\n";
+      kept.insert(*I);
+      if(LoadInst *lInst = dyn_cast<LoadInst>(*I)) getAccessSlots(lInst->getPointerOperand(), rawSlots);
+      changed = true;
+    }
+  }
+}
+
+// Enumerated pointer fields of the global struct an address points into, by
+// their byte offset from that address
+std::map<uint64_t,Value*> getPtrFields(Value *addr, const DataLayout &DL){
+  std::map<uint64_t,Value*> fields;
+  addr = addr->stripPointerCasts();
+  GlobalVariable *GV = dyn_cast<GlobalVariable>(addr);
+  APInt start(DL.getPointerSizeInBits(), 0);
+  if(GEPOperator *gepOp = dyn_cast<GEPOperator>(addr)){
+    GV = dyn_cast<GlobalVariable>(gepOp->getPointerOperand());
+    if(!GV || !gepOp->accumulateConstantOffset(DL, start)) return fields;
+  }
+  if(!GV || !GV->getValueType()->isStructTy()) return fields;
+  for(std::vector<Value*>::iterator obj = globalVarMap.begin(); obj != globalVarMap.end(); obj++){
+    GEPOperator *field = dyn_cast<GEPOperator>(*obj);
+    if(!field || field->getPointerOperand()!=GV || indexMap.find(field) == indexMap.end()) continue;
+    APInt fieldOff(DL.getPointerSizeInBits(), 0);
+    field->accumulateConstantOffset(DL, fieldOff);
+    if(fieldOff.uge(start)) fields[(fieldOff - start).getZExtValue()] = field;
+  }
+  return fields;
+}
+
+// Whole-struct writes move the pointer fields along with the bytes, so their
+// index and offset are written as well. The source is either an address, whose
+// fields at the same place are copied, or the index every field gets. Only the
+// fields within len bytes are written, all of them if len is not known. With a
+// condition the fields keep their value unless it holds.
+bool copyFieldIndices(IRBuilder<> &builder, Value *dst, Value *src, Value *len, Value *cond){
+  llvm::formatted_raw_ostream log(logFile);
+  const DataLayout &DL = builder.GetInsertBlock()->getModule()->getDataLayout();
+  std::map<uint64_t,Value*> dstFields = getPtrFields(dst, DL);
+  if(dstFields.empty()) return false;
+  std::map<uint64_t,Value*> srcFields;
+  if(src->getType()->isPointerTy()) srcFields = getPtrFields(src, DL);
+  ConstantInt *size = len ? dyn_cast<ConstantInt>(len) : NULL;
+  Type *intTy = TypeBuilder<int,false>::get(builder.getContext());
+  Value *fill = src->getType()->isPointerTy() ? ConstantInt::get(intTy, unknownIndex, true) : src;
+
+  // The source is read before anything is written, the two may overlap
+  std::vector<std::pair<Value*,Value*>> writes;
+  for(std::map<uint64_t,Value*>::iterator f = dstFields.begin(); f != dstFields.end(); f++){
+    uint64_t fieldSize = DL.getTypeStoreSize(f->second->getType()->getContainedType(0));
+    if(size && f->first + fieldSize > size->getZExtValue()) continue;
+    Value *idx = fill;
+    Value *off = ConstantInt::get(intTy, 0);
+    std::map<uint64_t,Value*>::iterator s = srcFields.find(f->first);
+    if(s != srcFields.end()){
+      idx = createLoad(builder, indexMap[s->second], getObjName(s->second) + "_copy");
+      if(offsetMap.find(s->second) != offsetMap.end())
+        off = createLoad(builder, offsetMap[s->second], getObjName(s->second) + "_offcopy");
+    }
+    writes.push_back(std::make_pair(indexMap[f->second], idx));
+    if(offsetMap.find(f->second) != offsetMap.end())
+      writes.push_back(std::make_pair(offsetMap[f->second], off));
+  }
+  for(std::vector<std::pair<Value*,Value*>>::iterator w = writes.begin(); w != writes.end(); w++){
+    Value *val = w->second;
+    if(cond){
+      Value *old = createLoad(builder, w->first, w->first->getName().str() + "_load");
+      val = builder.CreateSelect(cond, val, old, w->first->getName().str() + "_select");
+    }
+    Value *fieldStore = builder.CreateStore(val, w->first, true);
+    log << "Field copy: " << *fieldStore << "\n";
+  }
+  return !writes.empty();
+}
+
+// Fields written by a bulk operation take the index of the fields they are
+// copied from, a memset makes them null or unknown
+bool copyMemFields(IRBuilder<> &builder, MemIntrinsic *mi, Value *dst, Value *src){
+  if(MemSetInst *ms = dyn_cast<MemSetInst>(mi)){
+    ConstantInt *val = dyn_cast<ConstantInt>(ms->getValue());
+    Type *intTy = TypeBuilder<int,false>::get(builder.getContext());
+    src = ConstantInt::get(intTy, val && val->isZero() ? nullIndex : unknownIndex, true);
+  }
+  return copyFieldIndices(builder, dst, src, mi->getLength(), NULL);
+}
+
+// Fields written by a whole-struct store take the index of the fields it was
+// loaded from, anything else leaves them unknown
+bool storeFields(IRBuilder<> &builder, StoreInst *sInst, Value *dst, Value *cond){
+  Value *val = sInst->getValueOperand();
+  if(!val->getType()->isAggregateType()) return false;
+  Type *intTy = TypeBuilder<int,false>::get(builder.getContext());
+  Value *src = ConstantInt::get(intTy, unknownIndex, true);
+  if(LoadInst *lInst = dyn_cast<LoadInst>(val)) src = lInst->getPointerOperand();
+  const DataLayout &DL = sInst->getModule()->getDataLayout();
+  Value *len = builder.getInt64(DL.getTypeStoreSize(val->getType()));
+  return copyFieldIndices(builder, dst, src, len, cond);
+}
+
+// Candidates of a bulk memory operation, only data objects that are large 
+// enough can be targets
+std::vector<Value*> getMemTargets(Value *base, MemIntrinsic *mi){
+  std::vector<Value*> targets;
+  const DataLayout &DL = mi->getModule()->getDataLayout();
+  ConstantInt *len = dyn_cast<ConstantInt>(mi->getLength());
+  Instruction *baseInst = dyn_cast<Instruction>(base);
+  if(!baseInst) return targets;
+  std::vector<Value*> ptsToSet = ptsToGraph[baseInst];
+  for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+    if(isa<Function>(*j) || indexMap.find(*j) != indexMap.end()) continue;
+    Type *objTy = (*j)->getType()->getContainedType(0);
+    if(len && (!objTy->isSized() || DL.getTypeAllocSize(objTy) < len->getZExtValue())) continue;
+    targets.push_back(*j);
+  }
+  return targets;
+}
+
+// Rewrites memcpy, memmove and memset through enumerated pointers into one 
+// intrinsic per target, so that each target keeps a single bulk transfer
+bool lowerMemIntrinsic(MemIntrinsic *mi, std::map<Value*,Value*> &replaceMap){
+  llvm::formatted_raw_ostream log(logFile);
+  log << "Memory intrinsic: " << *mi << "\n";
+  Value *dst = mi->getRawDest();
+  Value *src = NULL;
+  if(MemTransferInst *mt = dyn_cast<MemTransferInst>(mi)) src = mt->getRawSource();
+
+  Value *dstBase = getEnumeratedBase(dst, replaceMap);
+  Value *srcBase = src ? getEnumeratedBase(src, replaceMap) : NULL;
+  if(!dstBase && !srcBase) return false;
+
+  std::vector<Value*> dstSet, srcSet;
+  if(dstBase) dstSet = getMemTargets(dstBase, mi);
+  if(srcBase) srcSet = getMemTargets(srcBase, mi);
+  log << "Targets: " << dstSet.size() << " destination(s), " << srcSet.size() << " source(s)\n";
+  if((dstBase && dstSet.size()==0) || (srcBase && srcSet.size()==0)) return false;
+
+  IRBuilder<> builder(mi);
+  Value *dstOff = dstBase ? getOffsetValue(builder, dstBase) : NULL;
+  Value *srcOff = srcBase ? getOffsetValue(builder, srcBase) : NULL;
+  std::string name = mi->getCalledFunction()->getName().str();
+  name = name.substr(name.find('.') + 1);
+  name = name.substr(0, name.find('.'));
+
+  CaseBodyFn emitSrc = [&](IRBuilder<> &caseBuilder, Value *dstAddr) -> Value* {
+    Value *newDst = dstBase ? rebaseAddr(caseBuilder, dst, dstBase, dstAddr, dstOff) : dst;
+    CaseBodyFn emitMem = [&](IRBuilder<> &innerBuilder, Value *srcAddr) -> Value* {
+      Instruction *newMI = mi->clone();
+      newMI->setOperand(0, newDst);
+      Value *newSrc = srcBase ? rebaseAddr(innerBuilder, src, srcBase, srcAddr, srcOff) : src;
+      if(srcBase) newMI->setOperand(1, newSrc);
+      innerBuilder.Insert(newMI);
+      log << "Bulk access: " << *newMI << "\n";
+      // Pointer fields of a struct target are copied or reset with the bytes
+      copyMemFields(innerBuilder, mi, newDst, newSrc);
+      return newMI;
+    };
+    if(srcBase)
+      emitIndexSwitch(caseBuilder, replaceMap[srcBase], srcSet, emitMem,
+          mi->getType(), name + "_src");
+    else
+      emitMem(caseBuilder, NULL);
+    return NULL;
+  };
+  // Profiling the indices or putting hot targets first
+  Function *F = mi->getParent()->getParent();
+  if(dstBase){
+    string site = getSiteKey(F, replaceMap[dstBase]);
+    if(ProfGen) instrumentSite(builder, site, replaceMap[dstBase]);
+    orderPtsTo(site, dstSet, true);
+  }
+  if(srcBase){
+    string site = getSiteKey(F, replaceMap[srcBase]);
+    if(ProfGen) instrumentSite(builder, site, replaceMap[srcBase]);
+    orderPtsTo(site, srcSet, true);
+  }
+
+  if(dstBase)
+    emitIndexSwitch(builder, replaceMap[dstBase], dstSet, emitSrc, mi->getType(), name + "_dst");
+  else
+    emitSrc(builder, NULL);
+
+  mi->eraseFromParent();
+  if(dstBase) removeDeadAddr(dst, dstBase);
+  if(srcBase) removeDeadAddr(src, srcBase);
+  return true;
+}
+
+// Gets the index global or index table behind the address of an index
+Value *getIndexBase(Value *ptr){
+  ptr = ptr->stripPointerCasts();
+  while(GEPOperator *gepOp = dyn_cast<GEPOperator>(ptr))
+    ptr = gepOp->getPointerOperand()->stripPointerCasts();
+  return ptr;
+}
+
+// Checks whether an index global or table starts with the unknown index
+bool hasUnknownInit(Constant *init){
+  if(ConstantInt *val = dyn_cast<ConstantInt>(init)) return val->getSExtValue() == unknownIndex;
+  for(unsigned k = 0; Constant *elem = init->getAggregateElement(k); k++)
+    if(hasUnknownInit(elem)) return true;
+  return false;
+}
+
+// Checks whether an index value can be the unknown index, given the index 
+// globals and tables that can hold it
+bool mayBeUnknown(Value *idx, std::set<Value*> &unknownVars, std::set<Value*> &visited){
+  if(!visited.insert(idx).second) return false;
+  if(ConstantInt *val = dyn_cast<ConstantInt>(idx)) return val->getSExtValue() == unknownIndex;
+  if(LoadInst *lInst = dyn_cast<LoadInst>(idx)){
+    Value *base = getIndexBase(lInst->getPointerOperand());
+    return !isIndexGlobal(base) || unknownVars.count(base);
+  }
+  if(SelectInst *sel = dyn_cast<SelectInst>(idx))
+    return mayBeUnknown(sel->getTrueValue(), unknownVars, visited) || 
+      mayBeUnknown(sel->getFalseValue(), unknownVars, visited);
+  if(PHINode *phi = dyn_cast<PHINode>(idx)){
+    for(unsigned k = 0; k < phi->getNumIncomingValues(); k++)
+      if(mayBeUnknown(phi->getIncomingValue(k), unknownVars, visited)) return true;
+    return false;
+  }
+  return true;
+}
+
+// Finds the index globals and tables that can hold the unknown index, from 
+// their initializer and the indices stored to them
+void findUnknownVars(Module *M, std::set<Value*> &unknownVars){
+  llvm::formatted_raw_ostream log(logFile);
+  for(std::map<Value*,Value*>::iterator v = indexMap.begin(); v != indexMap.end(); v++){
+    GlobalVariable *indexVar = dyn_cast<GlobalVariable>(v->second);
+    if(indexVar && indexVar->hasInitializer() && hasUnknownInit(indexVar->getInitializer()))
+      unknownVars.insert(indexVar);
+  }
+  // Indices are copied from one global to the other, so we go until nothing
+  // changes
+  bool changed = true;
+  while(changed){
+    changed = false;
+    for(Module::iterator F = M->begin(); F != M->end(); F++){
+      for(Function::iterator BB = F->begin(); BB != F->end(); BB++){
+        for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++){
+          StoreInst *sInst = dyn_cast<StoreInst>(I);
+          if(!sInst) continue;
+          Value *base = getIndexBase(sInst->getPointerOperand());
+          if(unknownVars.count(base) || !isIndexGlobal(base)) continue;
+          std::set<Value*> visited;
+          if(!mayBeUnknown(sInst->getValueOperand(), unknownVars, visited)) continue;
+          log << "Unknown index can reach " << base->getName() << "\n";
+          unknownVars.insert(base);
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+// Gets the index of a pointer argument by comparing it against each of its
+// candidates. A pointer that is none of them is null or unknown, unless the
+// candidates are every function of its type, which a function pointer can 
+// only point to.
+Value *getArgIndex(IRBuilder<> &builder, Argument *arg, std::vector<Value*> &candidates, bool complete){
+  Type *intTy = TypeBuilder<int,false>::get(builder.getContext());
+  PointerType *ptrTy = dyn_cast<PointerType>(arg->getType());
+  string name = arg->getName().str();
+  Value *idx = ConstantInt::get(intTy, complete ? nullIndex : unknownIndex, true);
+  if(!complete){
+    Value *nullCmp = builder.CreateICmpEQ(arg, ConstantPointerNull::get(ptrTy), name + "_null_cmp");
+    idx = builder.CreateSelect(nullCmp, ConstantInt::get(intTy, nullIndex, true), idx, name + "_null_select");
+  }
+  for(std::vector<Value*>::iterator j = candidates.begin(); j!= candidates.end(); j++){
+    Value *currCmp = builder.CreateICmpEQ(arg, decayAddr(builder, *j, ptrTy), name + getObjName(*j) + "_cmp");
+    Constant *index = ConstantInt::get(intTy, getIndex(*j), true);
+    idx = builder.CreateSelect(currCmp, index, idx, name + getObjName(*j) + "_select");
+  }
+  return idx;
+}
+
+// Candidates of a pointer argument, from the external points-to file or else
+// all objects or functions of its type
+std::vector<Value*> getArgCandidates(Argument *arg, bool &complete){
+  std::vector<Value*> candidates;
+  std::vector<Value*> &ptsToSet = argsPtsToGraph[arg];
+  complete = false;
+  if(ptsToSet.size()>0) return ptsToSet;
+  Type *elemTy = arg->getType()->getContainedType(0);
+  if(elemTy->isFunctionTy()){
+    complete = true;
+    for(std::vector<Value*>::iterator j = funcVarMap.begin(); j!= funcVarMap.end(); j++)
+      if(dyn_cast<Function>(*j)->getFunctionType()==elemTy) candidates.push_back(*j);
+    return candidates;
+  }
+  for(std::vector<Value*>::iterator j = globalVarMap.begin(); j!= globalVarMap.end(); j++)
+    if(decaysTo(*j, elemTy)) candidates.push_back(*j);
+  return candidates;
+}
+
+// Turns an indirect call into a switch over direct calls to its candidates.
+// The function pointer is either loaded from an enumerated global, which gives
+// us its index, or an argument, which we compare against each candidate. An
+// index that can be unknown keeps the call through the pointer as the default
+// instead of calling one of the candidates.
+bool lowerIndirectCall(CallInst *cInst, std::map<Value*,Value*> &replaceMap, std::set<Value*> &unknownVars){
+  llvm::formatted_raw_ostream log(logFile);
+  Value *callee = cInst->getCalledValue()->stripPointerCasts();
+  log << "Indirect call: " << *cInst << "\n";
+
+  // Candidates from the external call line first, then the load or argument
+  std::vector<Value*> ptsToSet = ptsToGraph[cInst];
+  if(ptsToSet.size()==0){
+    if(Instruction *calleeInst = dyn_cast<Instruction>(callee))
+      ptsToSet = ptsToGraph[calleeInst];
+    else if(Argument *arg = dyn_cast<Argument>(callee))
+      ptsToSet = argsPtsToGraph[arg];
+  }
+
+  std::vector<Value*> funcSet;
+  for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+    Function *fn = dyn_cast<Function>(*j);
+    if(fn && fn->getFunctionType()==cInst->getFunctionType()) funcSet.push_back(fn);
+  }
+  // Most conservative approach, all functions of the right type
+  bool complete = funcSet.size()==0;
+  if(funcSet.size()==0){
+    for(std::vector<Value*>::iterator j = funcVarMap.begin(); j!= funcVarMap.end(); j++){
+      Function *fn = dyn_cast<Function>(*j);
+      if(fn->getFunctionType()==cInst->getFunctionType()) funcSet.push_back(fn);
+    }
+  }
+  log << "that calls " << funcSet.size() << " function(s)\n";
+  if(funcSet.size()==0) return false;
+
+  IRBuilder<> builder(cInst);
+  Value *idx;
+  std::map<Value*,Value*>::iterator base = replaceMap.find(callee);
+  if (base != replaceMap.end()) {
+    log << "Replacement load: " << *base->second << "\n";
+    idx = base->second;
+  } else if(Argument *arg = dyn_cast<Argument>(callee)){
+    idx = getArgIndex(builder, arg, funcSet, complete);
+  } else {
+    log << "No index for callee\n";
+    return false;
+  }
+
+  // Profiling the index or putting hot functions first
+  string site = getSiteKey(cInst->getParent()->getParent(), idx);
+  if(ProfGen) instrumentSite(builder, site, idx);
+  orderPtsTo(site, funcSet, true);
+  std::set<Value*> visited;
+  if(mayBeUnknown(idx, unknownVars, visited)){
+    log << "Unknown index for callee\n";
+    funcSet.insert(funcSet.begin(), callee);
+  }
+
+  std::vector<Value*> args(cInst->arg_begin(), cInst->arg_end());
+  Value *repl = emitIndexSwitch(builder, idx, funcSet,
+      [&](IRBuilder<> &caseBuilder, Value *fn) -> Value* {
+        Function *directFn = dyn_cast<Function>(fn);
+        CallInst *directCall;
+        if(directFn){
+          directCall = caseBuilder.CreateCall(directFn, args);
+          directCall->setCallingConv(directFn->getCallingConv());
+        }else{
+          directCall = caseBuilder.CreateCall(cInst->getFunctionType(), cInst->getCalledValue(), args);
+          directCall->setCallingConv(cInst->getCallingConv());
+        }
+        directCall->setDebugLoc(cInst->getDebugLoc());
+        // The call site keeps its attributes (byval, sret, zeroext, ...)
+        directCall->setAttributes(cInst->getAttributes());
+        directCall->setTailCallKind(cInst->getTailCallKind());
+        if(isa<FPMathOperator>(cInst)) directCall->copyFastMathFlags(cInst);
+        log << "Direct call: " << *directCall << "\n";
+        return directCall;
+      }, cInst->getType(), cInst->getParent()->getParent()->getName().str() + "_call");
+
+  if(repl) cInst->replaceAllUsesWith(repl);
+  cInst->eraseFromParent();
+  return true;
+}
+
+// Checks whether a pointer value ends up with an index. Merges of pointers 
+// have one when all of their incoming pointers have one.
+bool isEnumerable(Value *val, std::set<Value*> &visited){
+  if(!visited.insert(val).second) return true;
+  if(isa<ConstantPointerNull>(val)) return true;
+  if(isa<Constant>(val)) return getIndex(getObject(val->stripPointerCasts()))>0;
+  if(LoadInst *lInst = dyn_cast<LoadInst>(val)){
+    Value *ptr = lInst->getPointerOperand();
+    if(getIndexAddr(ptr)) return true;
+    if(GetElementPtrInst *gepInst = dyn_cast<GetElementPtrInst>(ptr)) ptr = gepInst->getPointerOperand();
+    return isEnumerable(ptr, visited);
+  }
+  if(GetElementPtrInst *gepInst = dyn_cast<GetElementPtrInst>(val))
+    return isEnumerable(gepInst->getPointerOperand(), visited);
+  if(SelectInst *sel = dyn_cast<SelectInst>(val))
+    return isEnumerable(sel->getTrueValue(), visited) && isEnumerable(sel->getFalseValue(), visited);
+  if(PHINode *phi = dyn_cast<PHINode>(val)){
+    for(unsigned k = 0; k < phi->getNumIncomingValues(); k++)
+      if(!isEnumerable(phi->getIncomingValue(k), visited)) return false;
+    return true;
+  }
+  return false;
+}
+
+// The points-to set of a merge is the union of its incoming pointers
+void getMergePtsTo(Value *val, std::vector<Value*> &ptsToSet, std::set<Value*> &visited){
+  if(!visited.insert(val).second) return;
+  std::vector<Value*> inSet;
+  if(SelectInst *sel = dyn_cast<SelectInst>(val)){
+    getMergePtsTo(sel->getTrueValue(), ptsToSet, visited);
+    getMergePtsTo(sel->getFalseValue(), ptsToSet, visited);
+    return;
+  }
+  if(PHINode *phi = dyn_cast<PHINode>(val)){
+    for(unsigned k = 0; k < phi->getNumIncomingValues(); k++)
+      getMergePtsTo(phi->getIncomingValue(k), ptsToSet, visited);
+    return;
+  }
+  Instruction *inst = dyn_cast<Instruction>(val);
+  if(inst && ptsToGraph.find(inst) != ptsToGraph.end()) inSet = ptsToGraph[inst];
+  else if(GEPOperator *gepOp = dyn_cast<GEPOperator>(val))
+    getMergePtsTo(gepOp->getPointerOperand(), ptsToSet, visited);
+  else if(isa<Constant>(val) && getIndex(getObject(val->stripPointerCasts()))>0)
+    inSet.push_back(getObject(val->stripPointerCasts()));
+  for(std::vector<Value*>::iterator j = inSet.begin(); j != inSet.end(); j++)
+    if(std::find(ptsToSet.begin(), ptsToSet.end(), *j) == ptsToSet.end()) ptsToSet.push_back(*j);
+}
+
+// Merges of enumerated pointers become merges of their indices, and of their
+// offsets if pointers carry one. The incoming values of phis can come later in
+// the function, so phis are filled in once every pointer has an index.
+Value *lowerMerge(Instruction *I, std::map<Value*,Value*> &replaceMap, std::vector<PHINode*> &phiList){
+  llvm::formatted_raw_ostream log(logFile);
+  Type *intTy = TypeBuilder<int,false>::get(I->getContext());
+  Constant *zero = ConstantInt::get(intTy, 0);
+  Constant *unknown = ConstantInt::get(intTy, unknownIndex, true);
+  std::vector<Value*> ptsToSet;
+  std::set<Value*> visited;
+  getMergePtsTo(I, ptsToSet, visited);
+  ptsToGraph[I] = ptsToSet;
+  log << "Merge of " << ptsToSet.size() << " object(s): " << *I << "\n";
+
+  if(PHINode *phi = dyn_cast<PHINode>(I)){
+    PHINode *idxPhi = PHINode::Create(intTy, phi->getNumIncomingValues(), phi->getName().str() + "_index", phi);
+    if(!offsetMap.empty())
+      offsetValMap[phi] = PHINode::Create(intTy, phi->getNumIncomingValues(), phi->getName().str() + "_offset", phi);
+    phiList.push_back(phi);
+    return idxPhi;
+  }
+  SelectInst *sel = dyn_cast<SelectInst>(I);
+  IRBuilder<> builder(sel);
+  Value *trueIdx = getIndexValue(sel->getTrueValue(), replaceMap);
+  Value *falseIdx = getIndexValue(sel->getFalseValue(), replaceMap);
+  Value *idxSel = builder.CreateSelect(sel->getCondition(), trueIdx ? trueIdx : unknown, 
+      falseIdx ? falseIdx : unknown, sel->getName().str() + "_index");
+  Value *trueOff = getOffsetValue(builder, sel->getTrueValue());
+  Value *falseOff = getOffsetValue(builder, sel->getFalseValue());
+  if(trueOff || falseOff)
+    offsetValMap[sel] = builder.CreateSelect(sel->getCondition(), trueOff ? trueOff : zero, 
+        falseOff ? falseOff : zero, sel->getName().str() + "_offset");
+  log << "Index select: " << *idxSel << "\n";
+  return idxSel;
+}
+
+// Fills in the incoming indices and offsets of merged pointer phis
+void fillMergePhis(std::vector<PHINode*> &phiList, std::map<Value*,Value*> &replaceMap){
+  llvm::formatted_raw_ostream log(logFile);
+  for(std::vector<PHINode*>::iterator p = phiList.begin(); p != phiList.end(); p++){
+    PHINode *phi = *p;
+    Constant *zero = ConstantInt::get(TypeBuilder<int,false>::get(phi->getContext()), 0);
+    Constant *unknown = ConstantInt::get(TypeBuilder<int,false>::get(phi->getContext()), unknownIndex, true);
+    PHINode *idxPhi = dyn_cast<PHINode>(replaceMap[phi]);
+    PHINode *offPhi = NULL;
+    if(offsetValMap.find(phi) != offsetValMap.end()) offPhi = dyn_cast<PHINode>(offsetValMap[phi]);
+    for(unsigned k = 0; k < phi->getNumIncomingValues(); k++){
+      Value *val = phi->getIncomingValue(k);
+      BasicBlock *BB = phi->getIncomingBlock(k);
+      Value *idx = getIndexValue(val, replaceMap);
+      if(!idx) log << "No index for incoming " << *val << "\n";
+      idxPhi->addIncoming(idx ? idx : unknown, BB);
+      if(!offPhi) continue;
+      IRBuilder<> builder(BB->getTerminator());
+      Value *off = getOffsetValue(builder, val);
+      offPhi->addIncoming(off ? off : zero, BB);
+    }
+    log << "Index phi: " << *idxPhi << "\n";
+  }
+}
+
+// Allocation sites with a bound become pools of objects. A pool is a global 
+// array with a stack of free slots and its top, allocating pops a slot and 
+// free pushes it back. Pointers into a pool are its index with the slot as 
+// their offset.
+std::map<string,unsigned> poolBounds;
+std::map<Value*,Value*> poolFreeMap;
+std::map<Value*,Value*> poolTopMap;
+
+void readPoolBounds(){
+  llvm::formatted_raw_ostream log(logFile);
+  std::ifstream infile(PoolBounds.c_str());
+  if (!infile.is_open()) {
+    log << "No pool bounds " << PoolBounds << "\n";
+    return;
+  }
+  string line;
+  while(getline(infile,line)){
+    stringstream linestream(line);
+    string func,site,boundstr;
+    getline(linestream,func,':');
+    getline(linestream,site,':');
+    getline(linestream,boundstr,':');
+    unsigned bound;
+    stringstream convert(boundstr);
+    if(!(convert >> bound) || bound==0) continue;
+    poolBounds[func + ":" + site] = bound;
+  }
+  infile.close();
+  log << "Read bounds for " << poolBounds.size() << " allocation site(s)\n";
+}
+
+bool isLibCall(Instruction *I, string name){
+  CallInst *cInst = dyn_cast<CallInst>(I);
+  return cInst && cInst->getCalledFunction() && cInst->getCalledFunction()->getName() == name;
+}
+
+// Turns a malloc into a pop from the free stack of a new pool. The type of the
+// objects comes from the casts of the result, a size of several objects gives
+// a pool of arrays. Allocations whose type or size is unclear are left alone.
+bool lowerAlloc(CallInst *cInst, unsigned bound, string name){
+  llvm::formatted_raw_ostream log(logFile);
+  Module *M = cInst->getModule();
+  const DataLayout &DL = M->getDataLayout();
+  Type *intTy = TypeBuilder<int,false>::get(M->getContext());
+  log << "Allocation site " << name << ": " << *cInst << "\n";
+
+  PointerType *ptrTy = NULL;
+  for(auto user : cInst->users()){
+    BitCastInst *cast = dyn_cast<BitCastInst>(user);
+    if(!cast || (ptrTy && cast->getType()!=ptrTy)) ptrTy = NULL;
+    else ptrTy = dyn_cast<PointerType>(cast->getType());
+    if(!ptrTy) break;
+  }
+  ConstantInt *size = dyn_cast<ConstantInt>(cInst->getArgOperand(0));
+  if(!ptrTy || !size || !ptrTy->getContainedType(0)->isSized()){
+    log << "Allocation without a constant size and type\n";
+    return false;
+  }
+  Type *elemTy = ptrTy->getContainedType(0);
+  uint64_t elemSize = DL.getTypeAllocSize(elemTy);
+  if(elemSize==0 || size->isZero() || size->getZExtValue() % elemSize != 0){
+    log << "Allocation size does not fit the type\n";
+    return false;
+  }
+  uint64_t stride = size->getZExtValue() / elemSize;
+  Type *objTy = stride==1 ? elemTy : ArrayType::get(elemTy, stride);
+
+  ArrayType *poolTy = ArrayType::get(objTy, bound);
+  GlobalVariable *pool = new GlobalVariable(*M, poolTy, false, GlobalValue::ExternalLinkage,
+      Constant::getNullValue(poolTy), name);
+  // The free stack starts out with every slot. It is private, so it is not an
+  // object that pointers could point to.
+  std::vector<Constant*> slots;
+  for(unsigned k = 0; k < bound; k++) slots.push_back(ConstantInt::get(intTy, k));
+  ArrayType *freeTy = ArrayType::get(intTy, bound);
+  GlobalVariable *freeList = new GlobalVariable(*M, freeTy, false, GlobalValue::PrivateLinkage,
+      ConstantArray::get(freeTy, slots), name + "_free");
+  GlobalVariable *top = new GlobalVariable(*M, intTy, false, GlobalValue::PrivateLinkage,
+      ConstantInt::get(intTy, bound), name + "_top");
+  poolFreeMap[pool] = freeList;
+  poolTopMap[pool] = top;
+  log << "Creating pool " << *pool << "\n";
+
+  // An empty stack gives a null pointer, as malloc does
+  IRBuilder<> builder(cInst);
+  Constant *zero = ConstantInt::get(intTy, 0);
+  Value *topLoad = builder.CreateLoad(top, true, name + "_top_load");
+  Value *avail = builder.CreateICmpNE(topLoad, zero, name + "_avail");
+  Value *newTop = builder.CreateSelect(avail, builder.CreateSub(topLoad, ConstantInt::get(intTy, 1)),
+      zero, name + "_newtop");
+  Value *freeIdx[] = {zero, newTop};
+  Value *freeAddr = builder.CreateInBoundsGEP(freeList, freeIdx, name + "_free_addr");
+  Value *slot = builder.CreateLoad(freeAddr, true, name + "_slot");
+  builder.CreateStore(newTop, top, true);
+  std::vector<Value*> objIdx;
+  objIdx.push_back(zero);
+  objIdx.push_back(slot);
+  if(stride>1) objIdx.push_back(zero);
+  Value *obj = builder.CreateInBoundsGEP(pool, objIdx, name + "_obj");
+  Value *ptr = builder.CreateSelect(avail, obj, ConstantPointerNull::get(ptrTy), name + "_ptr");
+  log << "Allocating " << *ptr << "\n";
+
+  std::vector<User*> users(cInst->user_begin(), cInst->user_end());
+  for(auto user : users){
+    Instruction *cast = dyn_cast<Instruction>(user);
+    cast->replaceAllUsesWith(ptr);
+    cast->eraseFromParent();
+  }
+  cInst->eraseFromParent();
+  return true;
+}
+
+// Turns a free of an enumerated pointer into a push of its slot onto the free
+// stack of its pool
+bool lowerFree(CallInst *cInst, std::map<Value*,Value*> &replaceMap){
+  llvm::formatted_raw_ostream log(logFile);
+  const DataLayout &DL = cInst->getModule()->getDataLayout();
+  Type *intTy = TypeBuilder<int,false>::get(cInst->getContext());
+  Constant *zero = ConstantInt::get(intTy, 0);
+  Value *ptr = cInst->getArgOperand(0)->stripPointerCasts();
+  log << "Free: " << *cInst << "\n";
+  std::map<Value*,Value*>::iterator base = replaceMap.find(ptr);
+  if(base == replaceMap.end()){
+    log << "No index for freed pointer\n";
+    return false;
+  }
+
+  IRBuilder<> builder(cInst);
+  Value *off = getOffsetValue(builder, ptr);
+  if(!off) off = zero;
+  Type *elemTy = ptr->getType()->getContainedType(0);
+  // Only the pools the pointer can point into get a push
+  std::vector<Value*> ptsToSet = ptsToGraph[dyn_cast<Instruction>(ptr)];
+  for(std::map<Value*,Value*>::iterator p = poolTopMap.begin(); p != poolTopMap.end(); p++){
+    GlobalVariable *pool = dyn_cast<GlobalVariable>(p->first);
+    if(std::find(ptsToSet.begin(), ptsToSet.end(), pool) == ptsToSet.end()) continue;
+    string name = pool->getName().str();
+    // Offsets count elements of the freed pointer, a slot can hold several
+    Value *slot = off;
+    Type *objTy = pool->getValueType()->getArrayElementType();
+    if(elemTy->isSized() && DL.getTypeAllocSize(elemTy) < DL.getTypeAllocSize(objTy))
+      slot = builder.CreateUDiv(off, ConstantInt::get(intTy, 
+          DL.getTypeAllocSize(objTy) / DL.getTypeAllocSize(elemTy)), name + "_free_slot");
+
+    Constant *index = ConstantInt::get(intTy, getIndex(pool), true);
+    Value *isPool = builder.CreateICmpEQ(base->second, index, name + "_free_cmp");
+    Value *topLoad = builder.CreateLoad(p->second, true, name + "_top_load");
+    Value *freeIdx[] = {zero, builder.CreateSelect(isPool, topLoad, zero, name + "_push")};
+    Value *freeAddr = builder.CreateInBoundsGEP(poolFreeMap[pool], freeIdx, name + "_free_addr");
+    Value *oldSlot = builder.CreateLoad(freeAddr, true, name + "_free_load");
+    builder.CreateStore(builder.CreateSelect(isPool, slot, oldSlot, name + "_free_select"), freeAddr, true);
+    Value *newTop = builder.CreateAdd(topLoad, ConstantInt::get(intTy, 1), name + "_newtop");
+    builder.CreateStore(builder.CreateSelect(isPool, newTop, topLoad, name + "_top_select"), p->second, true);
+    log << "Pushing onto " << name << "\n";
+  }
+  Value *arg = cInst->getArgOperand(0);
+  cInst->eraseFromParent();
+  removeDeadAddr(arg, ptr);
+  return true;
+}
+
+// Compares of enumerated pointers become compares of their indices, and of 
+// their offsets if they carry one. Relational compares are only defined 
+// within one object, so they only look at the offsets. Every object that is
+// not enumerated has the unknown index, so a compare of two pointers that can
+// hold it is left on the pointers. A compare with a known object or null is
+// decided by the index alone.
+bool lowerPtrCompare(ICmpInst *cmp, std::map<Value*,Value*> &replaceMap, std::set<Value*> &unknownVars){
+  llvm::formatted_raw_ostream log(logFile);
+  Constant *zero = ConstantInt::get(TypeBuilder<int,false>::get(cmp->getContext()), 0);
+  Value *lhs = cmp->getOperand(0);
+  Value *rhs = cmp->getOperand(1);
+  Value *lhsIdx = getIndexValue(lhs, replaceMap);
+  Value *rhsIdx = getIndexValue(rhs, replaceMap);
+  if(!lhsIdx || !rhsIdx || (isa<Constant>(lhsIdx) && isa<Constant>(rhsIdx))){
+    log << "No index for pointer compare: " << *cmp << "\n";
+    return false;
+  }
+  std::set<Value*> lhsVisited, rhsVisited;
+  if((!isa<Constant>(rhsIdx) && mayBeUnknown(lhsIdx, unknownVars, lhsVisited)) ||
+      (!isa<Constant>(lhsIdx) && mayBeUnknown(rhsIdx, unknownVars, rhsVisited))){
+    log << "Unknown index for pointer compare: " << *cmp << "\n";
+    return false;
+  }
+
+  IRBuilder<> builder(cmp);
+  string name = cmp->getName().str();
+  Value *lhsOff = getOffsetValue(builder, lhs);
+  Value *rhsOff = getOffsetValue(builder, rhs);
+  Value *newCmp;
+  if(cmp->isEquality()){
+    newCmp = builder.CreateICmpEQ(lhsIdx, rhsIdx, name + "_idxcmp");
+    if(lhsOff || rhsOff)
+      newCmp = builder.CreateAnd(newCmp, builder.CreateICmpEQ(lhsOff ? lhsOff : zero, 
+            rhsOff ? rhsOff : zero, name + "_offcmp"), name + "_eq");
+    if(cmp->getPredicate() == ICmpInst::ICMP_NE) newCmp = builder.CreateNot(newCmp, name + "_ne");
+  }else{
+    newCmp = builder.CreateICmp(ICmpInst::getSignedPredicate(cmp->getPredicate()), 
+        lhsOff ? lhsOff : zero, rhsOff ? rhsOff : zero, name + "_offcmp");
+  }
+  log << "Pointer compare: " << *cmp << "\nbecomes " << *newCmp << "\n";
+  cmp->replaceAllUsesWith(newCmp);
+  cmp->eraseFromParent();
+  return true;
+}
+
+// Casts of enumerated pointers to integers hold the index in the upper half
+// and the offset in bytes in the lower half, so null is still 0, distinct 
+// objects never meet and addresses within an object keep their distance
+bool lowerPtrToInt(PtrToIntInst *cast, std::map<Value*,Value*> &replaceMap){
+  llvm::formatted_raw_ostream log(logFile);
+  const DataLayout &DL = cast->getModule()->getDataLayout();
+  Value *ptr = cast->getPointerOperand();
+  IntegerType *resTy = dyn_cast<IntegerType>(cast->getType());
+  Value *idx = getIndexValue(ptr, replaceMap);
+  if(!resTy || !idx || isa<Constant>(idx)){
+    log << "No index for pointer cast: " << *cast << "\n";
+    return false;
+  }
+
+  IRBuilder<> builder(cast);
+  string name = cast->getName().str();
+  Value *addr = builder.CreateShl(builder.CreateSExtOrTrunc(idx, resTy), resTy->getBitWidth()/2, name + "_idx");
+  Value *off = getOffsetValue(builder, ptr);
+  Type *elemTy = ptr->getType()->getContainedType(0);
+  if(off && elemTy->isSized()){
+    Value *bytes = builder.CreateMul(builder.CreateSExtOrTrunc(off, resTy), 
+        ConstantInt::get(resTy, DL.getTypeAllocSize(elemTy)), name + "_bytes");
+    addr = builder.CreateAdd(addr, bytes, name + "_addr");
+  }
+  log << "Pointer cast: " << *cast << "\nbecomes " << *addr << "\n";
+  cast->replaceAllUsesWith(addr);
+  cast->eraseFromParent();
+  return true;
+}
+
+// Index and offset loads in a loop that neither writes the index nor calls 
+// anything that could are hoisted to its preheader, along with the compares
+// on them. Inner loops go first so the decode can leave a whole nest.
+int hoistDecode(Loop *L, std::set<Value*> &decodeVars){
+  llvm::formatted_raw_ostream log(logFile);
+  int hoisted = 0;
+  for(Loop::iterator sub = L->begin(); sub != L->end(); sub++)
+    hoisted += hoistDecode(*sub, decodeVars);
+  BasicBlock *preheader = L->getLoopPreheader();
+  if(!preheader) return hoisted;
+  std::set<Value*> written;
+  for(Loop::block_iterator BB = L->block_begin(); BB != L->block_end(); BB++){
+    for(BasicBlock::iterator I = (*BB)->begin(); I != (*BB)->end(); I++){
+      if(StoreInst *sInst = dyn_cast<StoreInst>(I)) written.insert(sInst->getPointerOperand());
+      if(isa<CallInst>(I) && !isa<IntrinsicInst>(I)) return hoisted;
+    }
+  }
+
+  std::vector<Instruction*> hoistList;
+  for(Loop::block_iterator BB = L->block_begin(); BB != L->block_end(); BB++){
+    for(BasicBlock::iterator I = (*BB)->begin(); I != (*BB)->end(); I++){
+      LoadInst *lInst = dyn_cast<LoadInst>(I);
+      if(lInst && !lInst->isVolatile() && decodeVars.count(lInst->getPointerOperand()) && 
+          !written.count(lInst->getPointerOperand()))
+        hoistList.push_back(lInst);
+    }
+  }
+  for(std::vector<Instruction*>::iterator I = hoistList.begin(); I != hoistList.end(); I++)
+    (*I)->moveBefore(preheader->getTerminator());
+  hoisted += hoistList.size();
+
+  // Compares follow once the loads they decode are out of the loop
+  hoistList.clear();
+  for(Loop::block_iterator BB = L->block_begin(); BB != L->block_end(); BB++){
+    for(BasicBlock::iterator I = (*BB)->begin(); I != (*BB)->end(); I++){
+      if(isa<ICmpInst>(I) && decodeCmps.count(&*I) && L->hasLoopInvariantOperands(&*I))
+        hoistList.push_back(&*I);
+    }
+  }
+  for(std::vector<Instruction*>::iterator I = hoistList.begin(); I != hoistList.end(); I++)
+    (*I)->moveBefore(preheader->getTerminator());
+  hoisted += hoistList.size();
+  log << "Hoisted " << hoisted << " decode instructions to " << preheader->getName() << "\n";
+  return hoisted;
+}
+
+// Shares index loads within a block until the index is written, and compares
+// with an identical one that dominates them
+int shareDecode(Function *F, DominatorTree &DT, std::set<Value*> &decodeVars){
+  int shared = 0;
+  for(Function::iterator BB = F->begin(); BB != F->end(); BB++){
+    std::map<Value*,Instruction*> avail;
+    for(BasicBlock::iterator I = BB->begin(); I != BB->end(); ){
+      Instruction *inst = &*I++;
+      if(StoreInst *sInst = dyn_cast<StoreInst>(inst)) avail.erase(sInst->getPointerOperand());
+      else if(isa<CallInst>(inst) && !isa<IntrinsicInst>(inst)) avail.clear();
+      else if(LoadInst *lInst = dyn_cast<LoadInst>(inst)){
+        if(lInst->isVolatile() || !decodeVars.count(lInst->getPointerOperand())) continue;
+        std::map<Value*,Instruction*>::iterator prev = avail.find(lInst->getPointerOperand());
+        if(prev == avail.end()){
+          avail[lInst->getPointerOperand()] = lInst;
+          continue;
+        }
+        lInst->replaceAllUsesWith(prev->second);
+        lInst->eraseFromParent();
+        shared++;
+      }
+    }
+  }
+
+  std::map<std::pair<Value*,Value*>,std::vector<Instruction*>> cmpMap;
+  std::vector<Instruction*> cmpList;
+  for(Function::iterator BB = F->begin(); BB != F->end(); BB++)
+    for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++)
+      if(isa<ICmpInst>(I) && decodeCmps.count(&*I)) cmpList.push_back(&*I);
+  for(std::vector<Instruction*>::iterator I = cmpList.begin(); I != cmpList.end(); I++){
+    std::vector<Instruction*> &same = cmpMap[std::make_pair((*I)->getOperand(0), (*I)->getOperand(1))];
+    Instruction *dom = NULL;
+    for(std::vector<Instruction*>::iterator J = same.begin(); J != same.end() && !dom; J++)
+      if(DT.dominates(*J, *I)) dom = *J;
+    if(!dom){
+      same.push_back(*I);
+      continue;
+    }
+    (*I)->replaceAllUsesWith(dom);
+    decodeCmps.erase(*I);
+    (*I)->eraseFromParent();
+    shared++;
+  }
+  return shared;
+}
+
+// Allocation sites with a bound become pools, which are enumerated like any
+// other global
+bool lowerPools(Module *mod){
+  poolFreeMap.clear();
+  poolTopMap.clear();
+  poolBounds.clear();
+  if(PoolBounds.empty()) return false;
+  bool changed = false;
+  readPoolBounds();
+  for(Module::iterator F = mod->begin(); F != mod->end(); F++){
+    std::vector<CallInst*> allocList;
+    for(Function::iterator BB = F->begin(); BB != F->end(); BB++)
+      for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++)
+        if(isLibCall(&(*I), "malloc")) allocList.push_back(dyn_cast<CallInst>(&(*I)));
+    for(unsigned site = 0; site < allocList.size(); site++){
+      string key = F->getName().str() + ":" + std::to_string(site);
+      if(poolBounds.find(key) == poolBounds.end()) continue;
+      if(lowerAlloc(allocList[site], poolBounds[key], F->getName().str() + "_pool" + std::to_string(site)))
+        changed = true;
+    }
+  }
+  return changed;
+}
+
+// Runs the external points-to analysis when there is a config, script.sh 
+// writes the pointsTo.Vitis file that computePtsTo reads
+bool runExternalPtsTo(){
+  llvm::formatted_raw_ostream log(logFile);
+  if(!sys::fs::exists("config")){
+    log << "No config!\n";
+    return false;
+  }
+  log << "Found config!\n";
+  int retVal = system("./script.sh");
+  log << "Return value was " << retVal << "\n";
+  return true;
+}
+
+// Enumerates the objects of a module and finds what each access and argument
+// points to. Nothing is changed or written, so the result can be recomputed
+// at any time.
+void computePtsTo(Module *mod, PtsToInfo &info){
+  LLVMContext &c = mod->getContext();
+  SymbolTableList<GlobalVariable> *gList = &mod->getGlobalList();
+
+  // Creating indices for globals 
+  for (auto GV = gList->begin(); GV != gList->end(); GV++){
+    // Getting globals that are pointers 
+    //if(GV->getType()->isPointerTy()){
+      if(
+          // Avoiding all llvm metadata or strings 
+          GV->getLinkage()!=GlobalValue::PrivateLinkage && 
+          GV->getLinkage()!=GlobalValue::AppendingLinkage
+          // and not considering arrays either for now! 
+          //!GV->getType()->getContainedType(0)->isAggregateType()
+        ){
+        info.objects.push_back(&(*GV));
+      }
+    //}
+  }
+  // Creating indices for the fields of global structs
+  for (auto GV = gList->begin(); GV != gList->end(); GV++){
+    if(std::find(info.objects.begin(), info.objects.end(), &(*GV)) == info.objects.end()) continue;
+    if(!GV->getValueType()->isStructTy()) continue;
+    std::vector<Constant*> path;
+    path.push_back(ConstantInt::get(c, APInt(32,0)));
+    addFieldObjects(&(*GV), path, GV->getValueType(), info.objects);
+  }
+  // Creating indices for functions whose address is taken
+  for(Module::iterator F = mod->begin(); F != mod->end(); F++){
+    if(F->hasAddressTaken()) info.functions.push_back(&(*F));
+  }
+
+  if(!sys::fs::exists("config")){
+    // Find all loads and stores and assign points to all global variables 
+    // This is the most conservative approach 
+
+    for(Module::iterator F = mod->begin(); F != mod->end(); F++){
+      for(Function::iterator BB = F->begin(); BB != F->end(); BB++){
+        for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++){
+          if(isa<StoreInst>(I)||isa<LoadInst>(I)||isa<GetElementPtrInst>(I)){
+            info.ptsTo[&(*I)] = info.objects;
+          }
+        }
+      }
+    }
+  }
+  else
+  {
+    getExternalPtsTo(mod, info);
+  }
+
+  for(Module::iterator F = mod->begin(); F != mod->end(); F++){
+    for (Function::arg_iterator arg = F->arg_begin(); arg != F->arg_end(); arg++) {
+      getExternalPtsToForArgs(&(*arg), info);
+    }
+  }
+}
+
+// Takes the objects and points-to graph of a module for the rewrite
+void usePtsTo(const PtsToInfo &info){
+  llvm::formatted_raw_ostream log(logFile);
+  globalVarMap = info.objects;
+  funcVarMap = info.functions;
+  ptsToGraph = info.ptsTo;
+  argsPtsToGraph = info.argsPtsTo;
+  for(std::vector<Value*>::iterator obj = globalVarMap.begin(); obj != globalVarMap.end(); obj++)
+    log << "Pushing " << **obj << "\n";
+  for(std::vector<Value*>::iterator fn = funcVarMap.begin(); fn != funcVarMap.end(); fn++)
+    log << "Pushing function " << (*fn)->getName() << "\n";
+  printPtsTo();
+}
+
+// Replaces the pointers of a module by their indices, using the objects and
+// points-to graph computed by computePtsTo
+bool enumeratePtrs(Module &M){
+  LLVMContext &c = M.getContext();
+  Module *mod = &M;
+  SymbolTableList<GlobalVariable> *gList = &mod->getGlobalList();
+  llvm::formatted_raw_ostream log(logFile);
+  indexMap.clear();
+  offsetMap.clear();
+  offsetValMap.clear();
+  tableAddrMap.clear();
+  decodeCmps.clear();
+  siteCount.clear();
+  profSites.clear();
+  profile.clear();
+  ptsCount = 0;
+  instCount = 0;
+
+  // Identifies all global variables that are double pointers  
+  // For each identified variable, we create another variable that is not a pointer to hold the index
+  for (auto GV = gList->begin(); GV != gList->end(); GV++){
+    //int index = getIndex(&(*GV));
+    if(
+        isDoublePtr(&(*GV))
+        //|| GV->getType()->getContainedType(0)->isAggregateType()
+      ){
+      log << "Double pointer spotted: " << *GV << "\n";
+      Value *indexedGVal = M.getOrInsertGlobal(GV->getName().str() + "_index", TypeBuilder<int,false>::get(c));
+      GlobalVariable *indexedGVar = dyn_cast<GlobalVariable>(indexedGVal);       
+      indexedGVar->setInitializer(getIndexInit(getSlotInit(&(*GV)), indexedGVar->getValueType()));
+      log << "Creating global variable " << *indexedGVar; 
+      indexMap[&(*GV)] = indexedGVar;
+      log << "\n";
+    }
+  }
+  // Pointer fields of structs hold an index as well
+  for(std::vector<Value*>::iterator obj = globalVarMap.begin(); obj != globalVarMap.end(); obj++){
+    if(!isa<GEPOperator>(*obj) || !(*obj)->getType()->getContainedType(0)->isPointerTy()) continue;
+    log << "Pointer field spotted: " << **obj << "\n";
+    GlobalVariable *indexedGVar = new GlobalVariable(M, TypeBuilder<int,false>::get(c), false,
+        GlobalValue::ExternalLinkage, getIndexInit(getSlotInit(*obj), TypeBuilder<int,false>::get(c)), 
+        getObjName(*obj) + "_index");
+    log << "Creating global variable " << *indexedGVar << "\n"; 
+    indexMap[*obj] = indexedGVar;
+  }
+  // Pointer tables get an index table of the same shape, constant tables stay
+  // constant
+  for(std::vector<Value*>::iterator obj = globalVarMap.begin(); obj != globalVarMap.end(); obj++){
+    GlobalVariable *GV = dyn_cast<GlobalVariable>(*obj);
+    if(!GV || !isPtrTable(GV)) continue;
+    log << "Pointer table spotted: " << *GV << "\n";
+    Type *idxTy = getIndexType(GV->getValueType(), TypeBuilder<int,false>::get(c));
+    Constant *init = getIndexInit(GV->hasInitializer() ? GV->getInitializer() : NULL, idxTy);
+    GlobalVariable *indexedGVar = new GlobalVariable(M, idxTy, GV->isConstant(),
+        GlobalValue::ExternalLinkage, init, GV->getName().str() + "_index");
+    log << "Creating global variable " << *indexedGVar << "\n"; 
+    indexMap[GV] = indexedGVar;
+  }
+  log << "size of indexMap is " << indexMap.size() << "\n";
+
+  // Pointers moved by pointer arithmetic need an offset next to their index
+  findFatPointers(mod);
+  log << "size of offsetMap is " << offsetMap.size() << "\n";
+  // Set wherever the IR is rewritten, starting with the globals made above
+  bool changed = !indexMap.empty() || !offsetMap.empty();
+
+  if(!ProfUse.empty()) readProfile();
+
+
+  std::map<Value*,Value*> replaceMap;
+  std::vector<Instruction*> removalList;
+  std::vector<CallInst*> callList;
+  std::vector<MemIntrinsic*> memList;
+  std::vector<PHINode*> phiList;
+  std::vector<CallInst*> freeList;
+  std::vector<Instruction*> mergeList;
+  std::vector<Instruction*> ptrIntList;
+  Type *intTy = TypeBuilder<int,false>::get(c);
+
+  // Handle direct loads and stores to double pointers! 
+  for(Module::iterator F = mod->begin(); F != mod->end(); F++){
+    // Blocks are split while lowering, so we walk a snapshot of the instructions
+    std::vector<Instruction*> instList;
+    for(Function::iterator BB = F->begin(); BB != F->end(); BB++){
+      for(BasicBlock::iterator I = BB->begin(); I != BB->end(); I++){
+        instList.push_back(&(*I));
+      }
+    }
+    for(std::vector<Instruction*>::iterator inst = instList.begin(); inst != instList.end(); inst++){
+      Instruction *I = *inst;
+      // Setting insertion point.
+      IRBuilder<> builder(I->getParent());
+      builder.SetInsertPoint(&(*I));
+
+      // Merges of pointers
+      if((isa<PHINode>(I) || isa<SelectInst>(I)) && I->getType()->isPointerTy()){
+        std::set<Value*> visited;
+        if(isEnumerable(I, visited)){
+          replaceMap[I] = lowerMerge(I, replaceMap, phiList);
+          mergeList.push_back(I);
+        }
+      }
+
+      // Load instructions
+      log << "Instr: " << *I << "\n";
+      if(LoadInst *lInst = dyn_cast<LoadInst>(I)){
+        log << "Found load: " << *lInst << "\n";
+        // if address is in indexmap, then it is a direct access to a global 
+        Value *indexAddr = getIndexAddr(lInst->getPointerOperand());
+        if (indexAddr) {
+          instCount++;
+          // Simply replace the pointer-based load with a integer-based load
+          Value *oldLoad = indexAddr; 
+          Value *newLoad = createLoad(builder, oldLoad, oldLoad->getName().str() + "_load");
+          log << "Direct load:" << *newLoad << "\n";
+          Value *offAddr = getOffsetAddr(lInst->getPointerOperand());
+          if(offAddr){
+            offsetValMap[lInst] = createLoad(builder, offAddr, offAddr->getName().str() + "_load");
+            log << "Offset load: " << *offsetValMap[lInst] << "\n";
+          }
+
+          // House-keeping for replacing and removing redundant loads 
+          replaceMap.insert(std::pair<Value*, Value*>(lInst,newLoad));
+          removalList.push_back(lInst);
+          ptsCount++;
+        } else {
+          Instruction *load = dyn_cast<Instruction>(lInst->getPointerOperand());
+          if(load && (isa<LoadInst>(load) || isa<PHINode>(load) || isa<SelectInst>(load))){
+            log << "Found indirect load: " << *load << "\n";
+            // All indirect addresses are in the replacement map 
+            Value *addrCompLoad = NULL;
+            std::map<Value*,Value*>::iterator base = replaceMap.find(load);
+            if (base != replaceMap.end()) {
+              // Get the replacement load 
+              log << "Replacement load: " << *base->second << "\n";
+              addrCompLoad = base->second;
+            }
+            // Only pointers with an index can be enumerated
+            if (!addrCompLoad) continue;
+
+            // Get points-to set for the load instruction 
+            // This set can be the entire set of globals or an external input.  
+
+            std::vector<Value*> ptsToSet = ptsToGraph[load];
+            Value *prevLoad, *currLoad, *currCmp, *currSelect; 
+            log << "ptsTo size: " << ptsToSet.size() << "\n";
+            instCount++;
+            Value *off = getOffsetValue(builder, load);
+            std::vector<std::pair<Value*,Value*>> slots;
+
+            // Profiling the index or ordering by an existing profile
+            Value *hot = NULL, *hotAddr = NULL;
+            if(addrCompLoad){
+              string site = getSiteKey(&(*F), addrCompLoad);
+              if(ProfGen) instrumentSite(builder, site, addrCompLoad);
+              orderPtsTo(site, ptsToSet, false);
+              hot = getDominantTarget(site, ptsToSet);
+            }
+            Instruction *prev = lInst->getPrevNode();
+
+            int iteration = 0;
+            for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+              // Get address of points-to element, including if it is a pointer
+              // If it is a pointer, the element is in the indexMap
+              std::map<Value*,Value*>::iterator addrIt = indexMap.find(*j);
+              Value *addr; 
+              if (addrIt != indexMap.end()) addr = addrIt->second;
+              else addr = *j;
+
+              if(addr->getType()->getContainedType(0)->isAggregateType()){
+                // Pointers into an array read it at their offset
+                addr = getElemAddr(builder, *j, addr, off, lInst->getType());
+                if(!addr) continue;
+              }
+              else if(!isCompatible(*j, lInst->getType())) continue;
+
+              log << "Value " << *addr << "\n";
+
+              // Skip if the two variables are the same!
+              if(LoadInst *ld = dyn_cast<LoadInst>(addrCompLoad))
+                if(ld->getPointerOperand()==addr) continue;
+
+              ptsCount++;
+              if(*j==hot) hotAddr = addr;
+              if(lInst->getType()->isPointerTy()) slots.push_back(std::make_pair(*j, *j));
+              // Get relative distance of current element in points-to set
+              //int dist = std::distance(ptsToSet.begin(),
+              //    std::find(ptsToSet.begin(), ptsToSet.end(), &(**j)));
+
+              if(iteration==0){
+                // Create the first load in the points-to set
+                prevLoad = createLoad(builder, addr, getObjName(addr) + "_load");
+                log << "currLoad " << *prevLoad << "\n";
+                //break;
+                iteration++;
+                continue;
+              }
+              iteration++;
+
+              // For all points-to elements, create a load, get current index,
+              // compare the index and finally add select statement
+              currLoad = createLoad(builder, addr, getObjName(addr) + "_load");
+              currCmp = createIndexCmp(builder, addrCompLoad, *j, getObjName(addr) + "_cmp");
+              currSelect = builder.CreateSelect(currCmp,currLoad, prevLoad,
+                  getObjName(addr) + "_select");
+              prevLoad = currSelect;
+
+              log << "prevLoad" << *prevLoad << "\n";
+              log << "currLoad" << *currLoad << "\n";
+              log << "currCmp" << *currCmp << "\n";
+              log << "currSelect" << *currSelect << "\n";
+            }
+
+            // House-keeping replacing and removing loads 
+            if(iteration>0){
+              if(hotAddr && iteration>1){
+                Instruction *first = prev ? prev->getNextNode() : &lInst->getParent()->front();
+                prevLoad = peelAccess(first, lInst, addrCompLoad, hot, 
+                    [&](IRBuilder<> &directBuilder) -> Value* {
+                      Value *directAddr = cloneAddr(directBuilder, hotAddr);
+                      return createLoad(directBuilder, directAddr, getObjName(hotAddr) + "_direct");
+                    }, prevLoad, addrCompLoad->getName().str());
+              }
+              // Pointers read through pointers bring their offset along
+              builder.SetInsertPoint(lInst);
+              Value *loadOff = selectOffset(builder, addrCompLoad, slots, lInst->getName().str());
+              if(loadOff) offsetValMap[lInst] = loadOff;
+              log << "Pushed replacement map\n";
+              log << *lInst << " to " << *prevLoad << "\n";
+              replaceMap.insert(std::pair<Value*, Value*>(lInst,prevLoad));
+              removalList.push_back(lInst);
+            }
+          }
+          else if(GetElementPtrInst *gepInst = dyn_cast<GetElementPtrInst>(lInst->getPointerOperand())){
+            log << "Found an indirect GEP: " << *gepInst << "\n";
+            Instruction *pts = dyn_cast<Instruction>(gepInst);
+            std::vector<Value*> ptsToSet = ptsToGraph[pts];
+            log << "that points to " << ptsToSet.size() << " object(s)\n";
+            for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
+              log << "gepVec: " << **ind_begin << "\n";
+            }
+
+            Value* addrCompGep = gepInst->getPointerOperand();
+            std::map<Value*,Value*>::iterator base = replaceMap.find(gepInst->getPointerOperand());
+            if (base != replaceMap.end()) {
+              // Get the replacement store
+              log << "Replacement load: " << *base->second << "\n";
+              addrCompGep = base->second;
+            }
+            // Only pointers with an index can be enumerated
+            if (base == replaceMap.end()) continue;
+
+            Value *repInst;
+            instCount++;
+            Value *off = getOffsetValue(builder, gepInst->getPointerOperand());
+            std::vector<std::pair<Value*,Value*>> slots;
+
+            // Profiling the index or ordering by an existing profile
+            string site = getSiteKey(&(*F), addrCompGep);
+            if(ProfGen) instrumentSite(builder, site, addrCompGep);
+            orderPtsTo(site, ptsToSet, false);
+            Value *hot = getDominantTarget(site, ptsToSet);
+            Value *hotGep = NULL;
+            Instruction *prev = lInst->getPrevNode();
+
+            int iteration = 0;
+
+            for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+              // Get address of points-to element, including if it is a pointer
+              // If it is a pointer, the element is in the indexMap
+              //std::map<Value*,Value*>::iterator addrIt = indexMap.find(*j);
+              Value *addr; 
+              //if (addrIt != indexMap.end()) addr = addrIt->second;
+              //else 
+              addr = *j;
+
+              log << "Value " << *addr << "\n";
+              if(!addr->getType()->getContainedType(0)->isAggregateType()) continue;
+              if(!isGepCompatible(addr, gepInst)) continue;
+              log << "Proceeding!\n";
+              ptsCount++;
+
+              // Rebuilding the GEP on the element, multi-index GEPs end up at a 
+              // struct field. Pointer fields are read through their index.
+              log << "Num of indices " << gepInst->getNumIndices() << "\n";
+              log << "Addr is " << *addr << "\n";
+              Value *newGep = rebaseAddr(builder, gepInst, gepInst->getPointerOperand(), addr, off);
+              log << "New GEP generated!\n";
+              log << *newGep << "\n";
+              Value *accessAddr = getIndexAddr(newGep);
+              if(!accessAddr) accessAddr = newGep;
+              else slots.push_back(std::make_pair(addr, getFieldAddr(newGep)));
+              Value * currLoad = createLoad(builder, accessAddr, gepInst->getName().str() + getObjName(addr) + "_load");
+              log << "CurrLoad: " << *currLoad << "\n";
+              if(*j==hot) hotGep = addr;
+              // Get relative distance of current element in points-to set
+              //int dist = std::distance(ptsToSet.begin(),
+              //    std::find(ptsToSet.begin(), ptsToSet.end(), &(**j)));
+
+              if(iteration==0){
+                repInst = currLoad; 
+                iteration++;
+                continue;
+              }
+                iteration++;
+
+              Value *currCmp    = createIndexCmp(builder, addrCompGep, addr, gepInst->getName().str() +
+                  getObjName(addr) + "_cmp");
+              log << "CurrCmp: " << *currCmp << "\n";
+              Value *currSelect = builder.CreateSelect(currCmp, currLoad, repInst, gepInst->getName().str() + 
+                  getObjName(addr) + "_select");
+              repInst = currSelect;
+              log << "CurrSelect: " << *currSelect << "\n";
+            }
+            if(iteration>0){
+              if(hotGep && iteration>1){
+                Instruction *first = prev ? prev->getNextNode() : &lInst->getParent()->front();
+                repInst = peelAccess(first, lInst, addrCompGep, hot, 
+                    [&](IRBuilder<> &directBuilder) -> Value* {
+                      Value *directGep = rebaseAddr(directBuilder, gepInst, gepInst->getPointerOperand(), hotGep, off);
+                      if(Value *indexAddr = getIndexAddr(directGep)) directGep = indexAddr;
+                      return createLoad(directBuilder, directGep, gepInst->getName().str() + "_direct");
+                    }, repInst, gepInst->getName().str());
+              }
+              builder.SetInsertPoint(lInst);
+              Value *loadOff = selectOffset(builder, addrCompGep, slots, lInst->getName().str());
+              if(loadOff) offsetValMap[lInst] = loadOff;
+              log << "Replacing: \n";
+              log << *lInst << " with \n";
+              log << *repInst << "\n";
+              replaceMap.insert(std::pair<Value*, Value*>(lInst,repInst));
+              removalList.push_back(lInst);
+              //removalList.push_back(gepInst);
+            }
+          }
+          else {
+            instCount++;
+            ptsCount++;
+          }
+        }
+      }
+
+      // Bulk memory operations are lowered once their pointers have an index
+      if(MemIntrinsic *mi = dyn_cast<MemIntrinsic>(I)){
+        log << "Found memory intrinsic: " << *mi << "\n";
+        memList.push_back(mi);
+      }
+
+      // Pointer compares and casts to integers are lowered once their pointers
+      // have an index
+      ICmpInst *cmpInst = dyn_cast<ICmpInst>(I);
+      if((cmpInst && cmpInst->getOperand(0)->getType()->isPointerTy()) || isa<PtrToIntInst>(I)){
+        log << "Found pointer compare or cast: " << *I << "\n";
+        ptrIntList.push_back(I);
+      }
+
+      // Frees are lowered once their pointer has an index, enumerated pointers
+      // only ever point to globals and pool slots
+      if(isLibCall(I, "free")){
+        log << "Found free: " << *I << "\n";
+        freeList.push_back(dyn_cast<CallInst>(I));
+      }
+
+      // Indirect calls are lowered once their callee has an index
+      if(CallInst *cInst = dyn_cast<CallInst>(I)){
+        if(!cInst->getCalledFunction() && !cInst->isInlineAsm()){
+          log << "Found indirect call: " << *cInst << "\n";
+          callList.push_back(cInst);
+        }
+      }
+
+      // Store instructions 
+      if(StoreInst *sInst = dyn_cast<StoreInst>(I)){
+        log << "Store: " << *sInst << "\n";
+        log << "operand 0: " << *sInst->getOperand(0) << "\n";
+        log << "operand 1: " << *sInst->getOperand(1) << "\n";
+        Value *indexAddr = getIndexAddr(sInst->getPointerOperand());
+        if (indexAddr) {
+          instCount++;
+          int in;
+          if(GEPOperator *gepOp = dyn_cast<GEPOperator>(sInst->getOperand(0)))
+          {
+            log << "Found GEP: " << *gepOp << "\n";
+            log << "Found Address: " << *gepOp->getPointerOperand() << "\n";
+            in = getIndex(getObject(gepOp));
+          }else{
+            in = getIndex(sInst->getOperand(0));
+          }
+          log << "Index is " << in << "\n";
+          Constant *index = ConstantInt::get(intTy, in, true);
+          Value *indexVal = dyn_cast<Value>(index);
+          Value *addrVal = indexAddr; 
+          if(Argument *arg = dyn_cast<Argument>(sInst->getOperand(0))){
+            // Arguments are compared against what they can point to
+            log << "Argument spotted: "<< *arg <<"\n";
+            bool complete;
+            std::vector<Value*> candidates = getArgCandidates(arg, complete);
+            indexVal = getArgIndex(builder, arg, candidates, complete);
+          }
+          else if(in==0){
+            // Pointer arithmetic keeps the index of the pointer it starts from, 
+            // null and pointers we know nothing about have an index of their own
+            indexVal = getStoreValue(sInst->getOperand(0), replaceMap);
+          }
+          Value *newStore = builder.CreateStore(indexVal, addrVal, true);
+          log << "Injecting store " << *newStore << "\n";
+          Value *offAddr = getOffsetAddr(sInst->getPointerOperand());
+          if(offAddr){
+            Value *offVal = getOffsetValue(builder, sInst->getOperand(0));
+            if(!offVal) offVal = ConstantInt::get(intTy, 0);
+            Value *offStore = builder.CreateStore(offVal, offAddr, true);
+            log << "Injecting offset store " << *offStore << "\n";
+          }
+          removalList.push_back(sInst);
+          ptsCount++;
+        }
+        else{
+          Instruction *lInst = dyn_cast<Instruction>(sInst->getPointerOperand());
+          if(lInst && (isa<LoadInst>(lInst) || isa<PHINode>(lInst) || isa<SelectInst>(lInst))){
+            log << "Found indirect load: " << *lInst << "\n";
+            // All indirect addresses are in the replacement map 
+            Value *addrCompLoad = NULL;
+            std::map<Value*,Value*>::iterator base = replaceMap.find(lInst);
+            if (base != replaceMap.end()) {
+              // Get the replacement store
+              log << "Replacement load: " << *base->second << "\n";
+              addrCompLoad = base->second;
+            }
+            // Only pointers with an index can be enumerated
+            if (!addrCompLoad) continue;
+
+            // Get points-to set for the load instruction 
+            // This set can be the entire set of globals or an external input.  
+            std::vector<Value*> ptsToSet = ptsToGraph[lInst];
+            instCount++;
+            log << "ptsToSet size is " << ptsToSet.size() << "\n";
+            Value *off = getOffsetValue(builder, lInst);
+            Value *valOff = getOffsetValue(builder, sInst->getOperand(0));
+            std::vector<std::pair<Value*,Value*>> slots;
+
+            // Profiling the index or peeling with an existing profile
+            Value *hot = NULL, *hotAddr = NULL, *hotVal = NULL;
+            if(addrCompLoad){
+              string site = getSiteKey(&(*F), addrCompLoad);
+              if(ProfGen) instrumentSite(builder, site, addrCompLoad);
+              hot = getDominantTarget(site, ptsToSet);
+            }
+            Instruction *prev = sInst->getPrevNode();
+            bool stored = false;
+            
+            for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+              // Get address of points-to element, including if it is a pointer
+              // If it is a pointer, the element is in the indexMap
+              std::map<Value*,Value*>::iterator addrIt = indexMap.find(*j);
+              Value *addr; 
+              if (addrIt != indexMap.end()) addr = addrIt->second;
+              else addr = *j;
+              if(isReadOnly(*j)) continue;
+
+              Type *valTy = sInst->getValueOperand()->getType();
+              if(addr->getType()->getContainedType(0)->isAggregateType()){
+                // Pointers into an array write it at their offset
+                addr = getElemAddr(builder, *j, addr, off, valTy);
+                if(!addr) continue;
+              }
+              else if(!isCompatible(*j, valTy)) continue;
+              log << "Value " << *addr << "\n";
+
+              ptsCount++;
+              // Skip if the two variables are the same!
+              if(LoadInst *addrCompInst = dyn_cast<LoadInst>(addrCompLoad))
+                if(addrCompInst->getPointerOperand()==addr) continue;
+
+              // Get index if store value itself is a pointer  
+              Value *s1 = getStoreValue(sInst->getOperand(0), replaceMap);
+
+              log << "s1: " << *s1 << "\n";
+              if(*j==hot){
+                hotAddr = addr;
+                hotVal = s1;
+              }
+              if(valTy->isPointerTy()) slots.push_back(std::make_pair(*j, *j));
+
+              if(ptsToSet.size()==1){
+                Value *currStore  = builder.CreateStore(s1, addr, true);
+                log << "currStore" << *currStore  << "\n";
+                storeFields(builder, sInst, addr, NULL);
+                stored = true;
+                break;
+              }else{
+                Value *currLoad = createLoad(builder, addr, sInst->getName().str() + getObjName(addr) + "_load");
+                log << "currLoad" << *currLoad << "\n";
+                Value *currCmp    = createIndexCmp(builder, addrCompLoad, *j, 
+                    sInst->getName().str() + getObjName(addr) + "_cmp");
+                log << "currCmp" << *currCmp << "\n";
+                Value *currSelect = builder.CreateSelect(currCmp, s1, currLoad,
+                    sInst->getName().str() + getObjName(addr) + "_select");
+                log << "currSelect" << *currSelect  << "\n";
+                Value *currStore  = builder.CreateStore(currSelect, addr, true);
+                log << "currStore" << *currStore  << "\n";
+                storeFields(builder, sInst, addr, currCmp);
+                stored = true;
+              }
+            }
+            if(hotAddr && ptsToSet.size()>1){
+              Instruction *first = prev ? prev->getNextNode() : &sInst->getParent()->front();
+              peelAccess(first, sInst, addrCompLoad, hot, 
+                  [&](IRBuilder<> &directBuilder) -> Value* {
+                    Value *directAddr = cloneAddr(directBuilder, hotAddr);
+                    Value *directStore = directBuilder.CreateStore(hotVal, directAddr, true);
+                    storeFields(directBuilder, sInst, directAddr, NULL);
+                    return directStore;
+                  }, NULL, addrCompLoad->getName().str());
+            }
+            // Pointers written through pointers take their offset along
+            builder.SetInsertPoint(sInst);
+            storeOffset(builder, addrCompLoad, slots, valOff, sInst->getName().str());
+            // Stores without a target that can take them are left alone
+            if(stored) removalList.push_back(sInst);
+          } 
+          else if(GetElementPtrInst* gepInst = dyn_cast<GetElementPtrInst>(sInst->getPointerOperand())){
+            log << "Found indirect GEP: " << *gepInst << "\n";
+            for(auto ind_begin = gepInst->idx_begin(); ind_begin != gepInst->idx_end(); ind_begin++){
+              log << "gepVec: " << **ind_begin << "\n";
+            }
+            // All indirect addresses are in the replacement map 
+            Value *addrCompLoad = NULL; //= gepInst->getPointerOperand();
+            std::map<Value*,Value*>::iterator base = replaceMap.find(gepInst->getPointerOperand());
+            if (base != replaceMap.end()) {
+              // Get the replacement store
+              log << "Replacement load: " << *base->second << "\n";
+              addrCompLoad = base->second;
+            }
+            // Only pointers with an index can be enumerated, whole structs 
+            // written into a global struct still move its pointer fields
+            if (!addrCompLoad) {
+              storeFields(builder, sInst, gepInst, NULL);
+              continue;
+            }
+
+            // Get points-to set for the load instruction 
+            // This set can be the entire set of globals or an external input.  
+            std::vector<Value*> ptsToSet = ptsToGraph[gepInst];
+            instCount++;
+            Value *off = getOffsetValue(builder, gepInst->getPointerOperand());
+            Value *valOff = getOffsetValue(builder, sInst->getOperand(0));
+            std::vector<std::pair<Value*,Value*>> slots;
+
+            // Profiling the index or peeling with an existing profile
+            Value *hot = NULL, *hotGep = NULL, *hotVal = NULL;
+            if(addrCompLoad){
+              string site = getSiteKey(&(*F), addrCompLoad);
+              if(ProfGen) instrumentSite(builder, site, addrCompLoad);
+              hot = getDominantTarget(site, ptsToSet);
+            }
+            Instruction *prev = sInst->getPrevNode();
+            bool stored = false;
+            for(std::vector<Value*>::iterator j = ptsToSet.begin(); j!= ptsToSet.end(); j++){
+              // Get address of points-to element, including if it is a pointer
+              // If it is a pointer, the element is in the indexMap
+              Value *addr;
+              addr = *j;
+
+              log << "Value " << *addr << "\n";
+              if(!addr->getType()->getContainedType(0)->isAggregateType()) continue;
+              if(!isGepCompatible(addr, gepInst) || isReadOnly(addr)) continue;
+              log << "Proceeding!\n";
+              ptsCount++;
+
+              // Get index if store value itself is a pointer  
+              Value *s1 = getStoreValue(sInst->getOperand(0), replaceMap);
+
+              // Rebuilding the GEP on the element, multi-index GEPs end up at a 
+              // struct field. Pointer fields are written through their index.
+              log << "Num of indices " << gepInst->getNumIndices() << "\n";
+              log << "Addr is " << *addr << "\n";
+              Value *newGep = rebaseAddr(builder, gepInst, gepInst->getPointerOperand(), addr, off);
+              Value *accessAddr = getIndexAddr(newGep);
+              if(!accessAddr) accessAddr = newGep;
+              else slots.push_back(std::make_pair(addr, getFieldAddr(newGep)));
+
+              log << "New GEP: " << *newGep << "\n";
+              log << "Value " << *addr << "\n";
+              if(*j==hot){
+                hotGep = addr;
+                hotVal = s1;
+              }
+
+              if(ptsToSet.size()==1){
+                Value *currStore  = builder.CreateStore(s1, accessAddr, true);
+                log << "currStore" << *currStore  << "\n";
+                storeFields(builder, sInst, newGep, NULL);
+                stored = true;
+                break;
+              }
+              Value *currLoad = createLoad(builder, accessAddr, gepInst->getName().str() + getObjName(addr) + "_load");
+              log << "currLoad" << *currLoad << "\n";
+              Value *currCmp    = createIndexCmp(builder, addrCompLoad, addr, 
+                  gepInst->getName().str() + getObjName(addr) + "_cmp");
+              log << "currCmp" << *currCmp << "\n";
+              Value *currSelect = builder.CreateSelect(currCmp, s1, currLoad,
+                  gepInst->getName().str() + getObjName(addr) + "_select");
+              log << "currSelect" << *currSelect << "\n";
+              Value *currStore  = builder.CreateStore(currSelect, accessAddr, true);
+              log << "currStore" << *currStore  << "\n";
+              storeFields(builder, sInst, newGep, currCmp);
+              stored = true;
+            }
+            if(hotGep && ptsToSet.size()>1){
+              Instruction *first = prev ? prev->getNextNode() : &sInst->getParent()->front();
+              peelAccess(first, sInst, addrCompLoad, hot, 
+                  [&](IRBuilder<> &directBuilder) -> Value* {
+                    Value *directGep = rebaseAddr(directBuilder, gepInst, gepInst->getPointerOperand(), hotGep, off);
+                    Value *indexAddr = getIndexAddr(directGep);
+                    Value *directStore = directBuilder.CreateStore(hotVal, indexAddr ? indexAddr : directGep, true);
+                    storeFields(directBuilder, sInst, directGep, NULL);
+                    return directStore;
+                  }, NULL, gepInst->getName().str());
+            }
+            builder.SetInsertPoint(sInst);
+            storeOffset(builder, addrCompLoad, slots, valOff, sInst->getName().str());
+            if(stored) {
+              //removalList.push_back(gepInst);
+              removalList.push_back(sInst);
+            }
+          }
+          else {
+            instCount++;
+            // Whole structs written straight into a global copy their fields
+            if(storeFields(builder, sInst, sInst->getPointerOperand(), NULL)) changed = true;
+            ptsCount++;
+          }
+        }
+      }
+    }
+  }
+
+  fillMergePhis(phiList, replaceMap);
+  if(!replaceMap.empty() || !removalList.empty() || !mergeList.empty()) changed = true;
+
+  // Pushing freed slots back onto their pools
+  for(std::vector<CallInst*>::iterator call = freeList.begin(); call != freeList.end(); call++){
+    if(lowerFree(*call, replaceMap)){
+      ptsCount++;
+      changed = true;
+    }
+  }
+
+  // Replacing memory intrinsics through pointers with per-target intrinsics
+  for(std::vector<MemIntrinsic*>::iterator mi = memList.begin(); mi != memList.end(); mi++){
+    if(lowerMemIntrinsic(*mi, replaceMap)){
+      instCount++;
+      ptsCount++;
+      changed = true;
+    }
+    // Bulk operations straight on a global struct move its pointer fields
+    else{
+      IRBuilder<> builder(*mi);
+      MemTransferInst *mt = dyn_cast<MemTransferInst>(*mi);
+      if(copyMemFields(builder, *mi, (*mi)->getRawDest(), mt ? mt->getRawSource() : NULL)){
+        ptsCount++;
+        changed = true;
+      }
+    }
+  }
+
+  // Replacing pointer identity with integer compares on the indices, once all
+  // indices are stored
+  std::set<Value*> unknownVars;
+  findUnknownVars(mod, unknownVars);
+  for(std::vector<Instruction*>::iterator I = ptrIntList.begin(); I != ptrIntList.end(); I++){
+    bool lowered = false;
+    if(ICmpInst *cmpInst = dyn_cast<ICmpInst>(*I)) lowered = lowerPtrCompare(cmpInst, replaceMap, unknownVars);
+    else lowered = lowerPtrToInt(dyn_cast<PtrToIntInst>(*I), replaceMap);
+    instCount++;
+    if(lowered){
+      ptsCount++;
+      changed = true;
+    }
+  }
+
+  // Replacing indirect calls with a switch over direct calls
+  for(std::vector<CallInst*>::iterator call = callList.begin(); call != callList.end(); call++){
+    instCount++;
+    if(lowerIndirectCall(*call, replaceMap, unknownVars)){
+      ptsCount++;
+      changed = true;
+    }
+  }
+
+  // Pointers still read as pointers stay, along with the stores that keep 
+  // them in sync
+  std::set<Instruction*> kept;
+  findKeptPtrs(removalList, mergeList, kept);
+
+  // replacing all loads and stores that are now redundant 
+  for(std::map<Value*,Value*>::reverse_iterator map = replaceMap.rbegin(); map != replaceMap.rend(); map++){
+    log << "Replacement block\n";
+    log << "Use of: " << *map->first << "\n";
+    log << "Repl use by: " << *map->second << "\n";
+    bool keptPtr = kept.find(dyn_cast<Instruction>(map->first)) != kept.end();
+    // Uses go away as we replace them, so we walk a copy of them
+    std::vector<Use*> uses;
+    for (auto &U : map->first->uses()) uses.push_back(&U);
+    for (auto UI : uses) {
+      Use &U = *UI;
+      User *user = U.getUser();  // A User is anything with operands.
+      Instruction *u = dyn_cast<Instruction>(user);
+      log << "User: " << *u << "\n";
+      if(isa<GetElementPtrInst>(u)||isa<LoadInst>(u)||isa<BitCastInst>(u)) {
+        //removalList.push_back(u);
+        continue;
+      }
+      // Kept pointers are still read as pointers
+      if(keptPtr) continue;
+      if(StoreInst *sInst = dyn_cast<StoreInst>(u)){
+        if(U.getOperandNo()==0 && map->second!=u->getOperand(0)){
+          log << "Replacing Store value: " << *u << "\n";
+          user->setOperand(U.getOperandNo(), map->second);
+          log << "with\n" << *user << "\n";
+        }
+        continue;
+      }
+      if(map->second==u->getOperand(U.getOperandNo()))
+        continue;
+
+      log << "Replacing User: " << *u << "\n";
+      user->setOperand(U.getOperandNo(), map->second);
       log << "with\n" << *user << "\n";
     }
     std::vector<Value*> ptsToSet = ptsToGraph[dyn_cast<Instruction>(map->first)];
     log << "Size is " << ptsToSet.size() << "\n";
-    if(ptsToSet.size()==1){
+    if(ptsToSet.size()==1 && isa<LoadInst>(map->second)){
       // Dead code elimination
       Instruction *inst = dyn_cast<Instruction>(map->second);
       for (auto &U : map->first->uses()) {
         if(StoreInst *sInst = dyn_cast<StoreInst>(U.getUser())) continue;
+        if(std::find(removalList.begin(), removalList.end(), inst) != removalList.end()) break;
         log << "Removing inst: " << *inst << "\n";
         removalList.push_back(inst);
       }
     }
   }
 
+  // Merged pointers are left with the accesses that are removed below
+  for(std::vector<Instruction*>::iterator I = mergeList.begin(); I != mergeList.end(); I++){
+    if(kept.find(*I) != kept.end()) continue;
+    log << "Removing merge: " << **I << "\n";
+    (*I)->replaceAllUsesWith(UndefValue::get((*I)->getType()));
+    (*I)->eraseFromParent();
+  }
+
   // Removing instructions that are now not in use 
   for(std::vector<Instruction*>::reverse_iterator rmList = removalList.rbegin(); rmList != removalList.rend(); rmList++){
     Instruction *I = *rmList;
+    if(kept.find(I) != kept.end()){
+      log << "Keeping: " << *I << "\n";
+      continue;
+    }
     log << "Removing: " << *I << "\n";
-    for (auto &U : I->uses()) {
-      User *user = U.getUser();  // A User is anything with operands.
+    // Users are erased on the way, so we walk a copy of them
+    std::vector<User*> users(I->user_begin(), I->user_end());
+    for (auto user : users) {
       log << "User: " << *user << "\n"; 
       Instruction *rm = dyn_cast<Instruction>(user);
       /*for (auto &U1 : rm->uses()) {
@@ -888,10 +2860,111 @@ bool PtsToEnum::runOnModule(Module &M) {
         Instruction *rm1 = dyn_cast<Instruction>(user1);
         (*rm1).eraseFromParent();
         }*/
+      decodeCmps.erase(rm);
       (*rm).eraseFromParent();
     }
     (*rmList)->eraseFromParent();
   }
+  // Every access decodes its own index, the decode is shared afterwards and 
+  // hoisted out of loops that leave the index alone
+  std::set<Value*> decodeVars;
+  for(std::map<Value*,Value*>::iterator v = indexMap.begin(); v != indexMap.end(); v++){
+    GlobalVariable *indexVar = dyn_cast<GlobalVariable>(v->second);
+    if(indexVar && !indexVar->getValueType()->isAggregateType()) decodeVars.insert(indexVar);
+  }
+  for(std::map<Value*,Value*>::iterator v = offsetMap.begin(); v != offsetMap.end(); v++)
+    decodeVars.insert(v->second);
+  for(Module::iterator F = M.begin(); F != M.end(); F++){
+    if(F->isDeclaration()) continue;
+    DominatorTree DT(*F);
+    LoopInfo LI(DT);
+    int hoisted = 0;
+    for(LoopInfo::iterator L = LI.begin(); L != LI.end(); L++)
+      hoisted += hoistDecode(*L, decodeVars);
+    int shared = shareDecode(&*F, DT, decodeVars);
+    log << "Decode of " << F->getName() << ": hoisted " << hoisted << " shared " << shared << "\n";
+    if(hoisted>0 || shared>0) changed = true;
+  }
+  decodeCmps.clear();
+
+  if(ProfGen && profSites.size()>0){
+    emitProfileDump(mod);
+    changed = true;
+  }
   log << "PTSINFO! InstCount " << instCount << " PtsCount " << ptsCount << "\n";
-  return true;
+  return changed;
+}
+
+bool PtsToEnum::runOnModule(Module &M) {
+  bool changed = lowerPools(&M);
+  runExternalPtsTo();
+  PtsToInfo info;
+  computePtsTo(&M, info);
+  usePtsTo(info);
+  changed |= enumeratePtrs(M);
+  return changed;
+}
+
+const std::vector<Value*> &PtsToInfo::getPtsTo(Instruction *I) const {
+  static const std::vector<Value*> none;
+  std::map<Instruction*,std::vector<Value*>>::const_iterator it = ptsTo.find(I);
+  return it != ptsTo.end() ? it->second : none;
+}
+
+const std::vector<Value*> &PtsToInfo::getPtsTo(Argument *A) const {
+  static const std::vector<Value*> none;
+  std::map<Argument*,std::vector<Value*>>::const_iterator it = argsPtsTo.find(A);
+  return it != argsPtsTo.end() ? it->second : none;
+}
+
+int PtsToInfo::getIndex(Value *V) const {
+  std::vector<Value*>::const_iterator obj = std::find(objects.begin(), objects.end(), V);
+  if(obj != objects.end()) return std::distance(objects.begin(), obj) + 1;
+  std::vector<Value*>::const_iterator fn = std::find(functions.begin(), functions.end(), V);
+  if(fn != functions.end()) return std::distance(functions.begin(), fn) + 1;
+  return 0;
+}
+
+AnalysisKey PtsToAnalysis::Key;
+
+PtsToInfo PtsToAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  PtsToInfo info;
+  computePtsTo(&M, info);
+  return info;
+}
+
+PreservedAnalyses PtsToEnumPass::run(Module &M, ModuleAnalysisManager &MAM) {
+  // Pools add globals and the external analysis rewrites pointsTo.Vitis, so
+  // a points-to graph cached before either is stale. Nothing else is.
+  bool changed = lowerPools(&M);
+  bool ranScript = runExternalPtsTo();
+  if(changed || ranScript){
+    PreservedAnalyses PA = PreservedAnalyses::all();
+    PA.abandon<PtsToAnalysis>();
+    MAM.invalidate(M, PA);
+  }
+  usePtsTo(MAM.getResult<PtsToAnalysis>(M));
+  changed |= enumeratePtrs(M);
+  if(!changed) return PreservedAnalyses::all();
+  return PreservedAnalyses::none();
+}
+
+// Registers the analysis and the "ptsto-enum" pass for
+// opt -load-pass-plugin=LLVMPtsTo.so -passes=ptsto-enum
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "PtsToEnum", LLVM_VERSION_STRING,
+    [](PassBuilder &PB) {
+      PB.registerAnalysisRegistrationCallback(
+          [](ModuleAnalysisManager &MAM) {
+            MAM.registerPass([] { return PtsToAnalysis(); });
+          });
+      PB.registerPipelineParsingCallback(
+          [](StringRef Name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>) {
+            if(Name == "ptsto-enum"){
+              MPM.addPass(PtsToEnumPass());
+              return true;
+            }
+            return false;
+          });
+    }};
 }
@@ -0,0 +1,55 @@
+//===- PtsToEnum.h - Enumerating all pointer accesses  ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The points-to analysis and the enumeration pass for the new pass manager.
+// Other passes can query PtsToInfo through the analysis manager.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef PTSTOENUM_H
+#define PTSTOENUM_H
+
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+#include <map>
+#include <vector>
+
+/// The enumerated objects and functions of a module, and what each access and
+/// argument points to. An object's index is its position plus one, functions
+/// are numbered on their own, 0 is null.
+struct PtsToInfo {
+  std::vector<llvm::Value*> objects;
+  std::vector<llvm::Value*> functions;
+  std::map<llvm::Instruction*,std::vector<llvm::Value*>> ptsTo;
+  std::map<llvm::Argument*,std::vector<llvm::Value*>> argsPtsTo;
+
+  /// Objects and functions an access can point to, empty if nothing is known
+  const std::vector<llvm::Value*> &getPtsTo(llvm::Instruction *I) const;
+  /// Objects and functions an argument can point to, empty if nothing is known
+  const std::vector<llvm::Value*> &getPtsTo(llvm::Argument *A) const;
+  /// Index of an object or function, 0 if it is not enumerated
+  int getIndex(llvm::Value *V) const;
+};
+
+/// New pass manager analysis that computes the points-to graph, cached until
+/// a pass changes the module.
+struct PtsToAnalysis : public llvm::AnalysisInfoMixin<PtsToAnalysis> {
+  using Result = PtsToInfo;
+  Result run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+  static llvm::AnalysisKey Key;
+};
+
+/// New pass manager transform that enumerates pointer accesses with the
+/// result of PtsToAnalysis.
+struct PtsToEnumPass : public llvm::PassInfoMixin<PtsToEnumPass> {
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+};
+
+#endif